@@ -6,6 +6,11 @@ sizes=(64 128 256 512 1024 2048 4096 8192)
 # Defined the tile size for tiled programs
 tile_size=1
 
+# MPI ranks and OpenMP threads per rank of the MPI programs; for the hybrid engine run e.g. one rank per
+# socket: MPI_RANKS=2 THREADS_PER_RANK=8 ./bashScript.sh (the MPI programs must be built with -fopenmp)
+mpi_ranks=${MPI_RANKS:-4}
+threads_per_rank=${THREADS_PER_RANK:-1}
+
 # Initialized a variable to store the cumulative duration
 cumulative_duration=0
 test_count=0
@@ -20,7 +25,12 @@ run_and_time() {
 
     local start_time=$(date +%s.%N)
     if [[ "$is_mpi" == "yes" ]]; then
-        mpirun -np 4 ./$program $size $size $extra_arg # Adjust -np (number of processes) as needed
+        if [[ "$threads_per_rank" -gt 1 ]]; then
+            # Give every rank as many cores as it has threads and let it pin them inside that set
+            mpirun -np $mpi_ranks --map-by slot:PE=$threads_per_rank --bind-to core ./$program $size $size $extra_arg --threads=$threads_per_rank --affinity=compact
+        else
+            mpirun -np $mpi_ranks ./$program $size $size $extra_arg
+        fi
     else
         if [[ -n "$extra_arg" ]]; then
             ./$program $size $size $extra_arg
@@ -0,0 +1,380 @@
+/*
+ * Programmer(s) : Syed Saad Ullah Hussaini, K214703 Ali Raza, K213100 Muhammad Sameed
+ * Date: 17 October 2026
+ * Desc: Reduced precision matrix storage. The matrix is held as float32,
+ *       bfloat16 or int8 (with one scale per row) and the kernels widen the
+ *       elements on the fly while accumulating in double. Matrix vector
+ *       multiplication is bound by memory traffic, so 2-8x fewer bytes per
+ *       element make it proportionally faster and smaller.
+ */
+
+#ifndef MXV_LOWP_H
+#define MXV_LOWP_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include "mXv_matrix.h"
+#include "mXv_simd.h"
+
+typedef enum {
+    PRECISION_F64 = 0, // Plain double storage (the dense Matrix type)
+    PRECISION_F32,
+    PRECISION_BF16,
+    PRECISION_I8
+} Precision;
+
+typedef struct {
+    Precision precision;
+    int rows;
+    int cols;
+    int ld;          // Row stride in elements, a whole number of cache lines
+    void* data;      // rows * ld elements of lowpElementSize(precision) bytes, 64-byte aligned
+    double* scales;  // One scale per row for PRECISION_I8, NULL otherwise
+} LowpMatrix;
+
+// Function returning the number of bytes of one stored element
+static inline int lowpElementSize(Precision precision) {
+    switch (precision) {
+    case PRECISION_F32:
+        return 4;
+    case PRECISION_BF16:
+        return 2;
+    case PRECISION_I8:
+        return 1;
+    default:
+        return 8;
+    }
+}
+
+// Pointer to the first stored element of row i
+static inline void* lowpRow(const LowpMatrix* matrix, int i) {
+    return (char*)matrix->data + (size_t)i * matrix->ld * lowpElementSize(matrix->precision);
+}
+
+// Function to round a double to bfloat16 (round to nearest even)
+static inline uint16_t doubleToBf16(double value) {
+    float f = (float)value;
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    if ((bits & 0x7fffffffu) > 0x7f800000u) {
+        return (uint16_t)((bits >> 16) | 0x40); // Keep NaNs quiet
+    }
+    bits += 0x7fffu + ((bits >> 16) & 1u);
+    return (uint16_t)(bits >> 16);
+}
+
+// Function to widen a bfloat16 back to double
+static inline double bf16ToDouble(uint16_t value) {
+    uint32_t bits = (uint32_t)value << 16;
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+// Function to allocate an uninitialised reduced precision matrix; data is NULL on failure
+static inline LowpMatrix allocLowpMatrix(int rows, int cols, Precision precision) {
+    LowpMatrix matrix;
+    int perLine = MATRIX_ALIGNMENT / lowpElementSize(precision);
+    matrix.precision = precision;
+    matrix.rows = rows;
+    matrix.cols = cols;
+    matrix.ld = (cols + perLine - 1) / perLine * perLine;
+    matrix.data = NULL;
+    matrix.scales = NULL;
+    size_t bytes = (size_t)rows * matrix.ld * lowpElementSize(precision);
+    if (posix_memalign(&matrix.data, MATRIX_ALIGNMENT, bytes > 0 ? bytes : 1) != 0) {
+        matrix.data = NULL;
+        return matrix;
+    }
+    if (precision == PRECISION_I8) {
+        matrix.scales = allocAligned(rows);
+        if (matrix.scales == NULL) {
+            free(matrix.data);
+            matrix.data = NULL;
+        }
+    }
+    return matrix;
+}
+
+// Function to release the storage of a reduced precision matrix
+static inline void freeLowpMatrix(LowpMatrix* matrix) {
+    free(matrix->data);
+    free(matrix->scales);
+    matrix->data = NULL;
+    matrix->scales = NULL;
+}
+
+// Function to store one row of doubles into row i, zeroing the padding
+static inline void lowpStoreRow(LowpMatrix* matrix, int i, const double* values) {
+    void* row = lowpRow(matrix, i);
+    int cols = matrix->cols;
+    memset(row, 0, (size_t)matrix->ld * lowpElementSize(matrix->precision));
+    if (matrix->precision == PRECISION_F32) {
+        float* out = (float*)row;
+        for (int j = 0; j < cols; j++) {
+            out[j] = (float)values[j];
+        }
+    } else if (matrix->precision == PRECISION_BF16) {
+        uint16_t* out = (uint16_t*)row;
+        for (int j = 0; j < cols; j++) {
+            out[j] = doubleToBf16(values[j]);
+        }
+    } else if (matrix->precision == PRECISION_I8) {
+        // Symmetric quantisation: the largest magnitude of the row maps to 127
+        int8_t* out = (int8_t*)row;
+        double maxAbs = 0.0;
+        for (int j = 0; j < cols; j++) {
+            maxAbs = fabs(values[j]) > maxAbs ? fabs(values[j]) : maxAbs;
+        }
+        double scale = maxAbs > 0.0 ? maxAbs / 127.0 : 1.0;
+        for (int j = 0; j < cols; j++) {
+            long q = lrint(values[j] / scale);
+            out[j] = (int8_t)(q > 127 ? 127 : (q < -127 ? -127 : q));
+        }
+        matrix->scales[i] = scale;
+    }
+}
+
+// Function to fill rows [rowBegin, rowEnd) with the random values createMatrix would produce for
+// global rows firstRow + i, rounded to the storage format; one row of doubles is held at a time
+static inline int fillLowpRows(LowpMatrix* matrix, uint64_t key, int rowBegin, int rowEnd, int firstRow) {
+    double* values = allocAligned(matrix->cols);
+    if (values == NULL) {
+        return -1;
+    }
+    for (int i = rowBegin; i < rowEnd; i++) {
+        for (int j = 0; j < matrix->cols; j++) {
+            values[j] = randomUniform(key, (uint64_t)(firstRow + i), (uint64_t)j);
+        }
+        lowpStoreRow(matrix, i, values);
+    }
+    free(values);
+    return 0;
+}
+
+// Function to create a reduced precision random matrix; with OpenMP every thread fills its own rowBand
+static inline LowpMatrix createLowpMatrix(int rows, int cols, Precision precision, uint64_t key) {
+    LowpMatrix matrix = allocLowpMatrix(rows, cols, precision);
+    if (matrix.data == NULL) {
+        return matrix;
+    }
+    int failed = 0;
+#ifdef _OPENMP
+    #pragma omp parallel reduction(|:failed)
+    {
+        int rowBegin, rowEnd;
+        rowBand(rows, omp_get_num_threads(), omp_get_thread_num(), &rowBegin, &rowEnd);
+        failed |= fillLowpRows(&matrix, key, rowBegin, rowEnd, 0) != 0;
+    }
+#else
+    failed = fillLowpRows(&matrix, key, 0, rows, 0) != 0;
+#endif
+    if (failed) {
+        freeLowpMatrix(&matrix);
+    }
+    return matrix;
+}
+
+// Function to read element j of a stored row as a double (without the int8 row scale)
+static inline double lowpElement(Precision precision, const void* row, int j) {
+    switch (precision) {
+    case PRECISION_F32:
+        return ((const float*)row)[j];
+    case PRECISION_BF16:
+        return bf16ToDouble(((const uint16_t*)row)[j]);
+    case PRECISION_I8:
+        return ((const int8_t*)row)[j];
+    default:
+        return ((const double*)row)[j];
+    }
+}
+
+// A kernel computes result[i] = row i . vector for rowBegin <= i < rowEnd
+typedef void (*LowpKernel)(const LowpMatrix* matrix, const double* vector, double* result, int rowBegin, int rowEnd);
+
+// Function for the scaled dot product of row i with the vector, one element at a time
+static inline double lowpDotScalar(const LowpMatrix* matrix, int i, const double* vector) {
+    const void* row = lowpRow(matrix, i);
+    double s0 = 0.0, s1 = 0.0;
+    int j = 0;
+    for (; j + 2 <= matrix->cols; j += 2) {
+        s0 += lowpElement(matrix->precision, row, j) * vector[j];
+        s1 += lowpElement(matrix->precision, row, j + 1) * vector[j + 1];
+    }
+    for (; j < matrix->cols; j++) {
+        s0 += lowpElement(matrix->precision, row, j) * vector[j];
+    }
+    return s0 + s1;
+}
+
+static void lowpGemvScalar(const LowpMatrix* matrix, const double* vector, double* result, int rowBegin, int rowEnd) {
+    for (int i = rowBegin; i < rowEnd; i++) {
+        double scale = matrix->precision == PRECISION_I8 ? matrix->scales[i] : 1.0;
+        result[i] = lowpDotScalar(matrix, i, vector) * scale;
+    }
+}
+
+#ifdef MXV_X86
+
+// Function to widen 8 stored elements to 8 floats (exact for every format)
+__attribute__((target("avx2,fma"), always_inline))
+static inline __m256 lowpLoad8Avx2(Precision precision, const void* row, int j) {
+    if (precision == PRECISION_F32) {
+        return _mm256_loadu_ps((const float*)row + j);
+    } else if (precision == PRECISION_BF16) {
+        __m128i bits = _mm_loadu_si128((const __m128i*)((const uint16_t*)row + j));
+        return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_cvtepu16_epi32(bits), 16));
+    }
+    __m128i bytes = _mm_loadl_epi64((const __m128i*)((const int8_t*)row + j));
+    return _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(bytes));
+}
+
+// Dot product of one stored row with the vector; precision is a constant at every call site
+__attribute__((target("avx2,fma"), always_inline))
+static inline double lowpDotAvx2(Precision precision, const LowpMatrix* matrix, int i, const double* vector) {
+    const void* row = lowpRow(matrix, i);
+    int cols = matrix->cols;
+    __m256d a0 = _mm256_setzero_pd(), a1 = _mm256_setzero_pd();
+    int j = 0;
+    for (; j + 8 <= cols; j += 8) {
+        __m256 v = lowpLoad8Avx2(precision, row, j);
+        a0 = _mm256_fmadd_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(v)), _mm256_loadu_pd(vector + j), a0);
+        a1 = _mm256_fmadd_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(v, 1)), _mm256_loadu_pd(vector + j + 4), a1);
+    }
+    __m256d s = _mm256_add_pd(a0, a1);
+    __m128d h = _mm_add_pd(_mm256_castpd256_pd128(s), _mm256_extractf128_pd(s, 1));
+    double sum = _mm_cvtsd_f64(_mm_add_sd(h, _mm_unpackhi_pd(h, h)));
+    for (; j < cols; j++) {
+        sum += lowpElement(precision, row, j) * vector[j];
+    }
+    return sum;
+}
+
+__attribute__((target("avx2,fma")))
+static void lowpGemvAvx2(const LowpMatrix* matrix, const double* vector, double* result, int rowBegin, int rowEnd) {
+    switch (matrix->precision) {
+    case PRECISION_F32:
+        for (int i = rowBegin; i < rowEnd; i++) {
+            result[i] = lowpDotAvx2(PRECISION_F32, matrix, i, vector);
+        }
+        break;
+    case PRECISION_BF16:
+        for (int i = rowBegin; i < rowEnd; i++) {
+            result[i] = lowpDotAvx2(PRECISION_BF16, matrix, i, vector);
+        }
+        break;
+    case PRECISION_I8:
+        for (int i = rowBegin; i < rowEnd; i++) {
+            result[i] = lowpDotAvx2(PRECISION_I8, matrix, i, vector) * matrix->scales[i];
+        }
+        break;
+    default:
+        lowpGemvScalar(matrix, vector, result, rowBegin, rowEnd);
+    }
+}
+
+// Function to widen 16 stored elements to 16 floats (exact for every format)
+__attribute__((target("avx512f"), always_inline))
+static inline __m512 lowpLoad16Avx512(Precision precision, const void* row, int j) {
+    if (precision == PRECISION_F32) {
+        return _mm512_loadu_ps((const float*)row + j);
+    } else if (precision == PRECISION_BF16) {
+        __m256i bits = _mm256_loadu_si256((const __m256i*)((const uint16_t*)row + j));
+        return _mm512_castsi512_ps(_mm512_slli_epi32(_mm512_cvtepu16_epi32(bits), 16));
+    }
+    __m128i bytes = _mm_loadu_si128((const __m128i*)((const int8_t*)row + j));
+    return _mm512_cvtepi32_ps(_mm512_cvtepi8_epi32(bytes));
+}
+
+// Dot product of one stored row with the vector; precision is a constant at every call site
+__attribute__((target("avx512f"), always_inline))
+static inline double lowpDotAvx512(Precision precision, const LowpMatrix* matrix, int i, const double* vector) {
+    const void* row = lowpRow(matrix, i);
+    int cols = matrix->cols;
+    __m512d a0 = _mm512_setzero_pd(), a1 = _mm512_setzero_pd();
+    int j = 0;
+    for (; j + 16 <= cols; j += 16) {
+        __m512 v = lowpLoad16Avx512(precision, row, j);
+        __m256 lo = _mm512_castps512_ps256(v);
+        __m256 hi = _mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(v), 1));
+        a0 = _mm512_fmadd_pd(_mm512_cvtps_pd(lo), _mm512_loadu_pd(vector + j), a0);
+        a1 = _mm512_fmadd_pd(_mm512_cvtps_pd(hi), _mm512_loadu_pd(vector + j + 8), a1);
+    }
+    double sum = _mm512_reduce_add_pd(_mm512_add_pd(a0, a1));
+    for (; j < cols; j++) {
+        sum += lowpElement(precision, row, j) * vector[j];
+    }
+    return sum;
+}
+
+__attribute__((target("avx512f")))
+static void lowpGemvAvx512(const LowpMatrix* matrix, const double* vector, double* result, int rowBegin, int rowEnd) {
+    switch (matrix->precision) {
+    case PRECISION_F32:
+        for (int i = rowBegin; i < rowEnd; i++) {
+            result[i] = lowpDotAvx512(PRECISION_F32, matrix, i, vector);
+        }
+        break;
+    case PRECISION_BF16:
+        for (int i = rowBegin; i < rowEnd; i++) {
+            result[i] = lowpDotAvx512(PRECISION_BF16, matrix, i, vector);
+        }
+        break;
+    case PRECISION_I8:
+        for (int i = rowBegin; i < rowEnd; i++) {
+            result[i] = lowpDotAvx512(PRECISION_I8, matrix, i, vector) * matrix->scales[i];
+        }
+        break;
+    default:
+        lowpGemvScalar(matrix, vector, result, rowBegin, rowEnd);
+    }
+}
+
+#endif // MXV_X86
+
+// Function to pick the reduced precision kernel matching the dense kernel chosen in mXv_simd.h
+static inline LowpKernel selectLowpKernel(void) {
+#ifdef MXV_X86
+    const char* level = selectGemvKernelInfo()->name;
+    if (strcmp(level, "avx512") == 0) {
+        return lowpGemvAvx512;
+    }
+    if (strcmp(level, "avx2") == 0) {
+        return lowpGemvAvx2;
+    }
+#endif
+    return lowpGemvScalar;
+}
+
+// Function for cache-blocked reduced precision multiplication of rows [rowBegin, rowEnd), the
+// counterpart of gemvTiledBand: partial and acc must hold rowEnd - rowBegin doubles
+static inline void lowpTiledBand(LowpKernel kernel, const LowpMatrix* matrix, const double* vector, double* result,
+                                 int rowBegin, int rowEnd, int tileCols, double* partial, double* acc) {
+    int bandRows = rowEnd - rowBegin;
+    if (bandRows <= 0) {
+        return;
+    }
+    memset(acc, 0, bandRows * sizeof(double));
+    for (int colBegin = 0; colBegin < matrix->cols; colBegin += tileCols) {
+        int colEnd = colBegin + tileCols < matrix->cols ? colBegin + tileCols : matrix->cols;
+
+        // View of the rows of the band restricted to this column tile; the int8 row scales
+        // apply to every tile of a row, so the partial sums can simply be added up
+        LowpMatrix tile = *matrix;
+        tile.data = (char*)lowpRow(matrix, rowBegin) + (size_t)colBegin * lowpElementSize(matrix->precision);
+        tile.scales = matrix->scales != NULL ? matrix->scales + rowBegin : NULL;
+        tile.rows = bandRows;
+        tile.cols = colEnd - colBegin;
+
+        kernel(&tile, vector + colBegin, partial, 0, bandRows);
+        for (int i = 0; i < bandRows; i++) {
+            acc[i] += partial[i];
+        }
+    }
+    memcpy(result + rowBegin, acc, bandRows * sizeof(double));
+}
+
+#endif // MXV_LOWP_H
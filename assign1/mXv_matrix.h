@@ -0,0 +1,145 @@
+/*
+ * Programmer(s) : Syed Saad Ullah Hussaini, K214703 Ali Raza, K213100 Muhammad Sameed
+ * Date: 17 October 2026
+ * Desc: Matrix storage shared by all the matrix vector multiplication programs.
+ *       A matrix is one 64-byte aligned allocation of rows * ld doubles, where
+ *       ld (the leading dimension) is the row stride rounded up to a whole
+ *       cache line so every row starts on an aligned boundary.
+ */
+
+#ifndef MXV_MATRIX_H
+#define MXV_MATRIX_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mXv_random.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Alignment (in bytes) of every matrix and vector allocation
+#define MATRIX_ALIGNMENT 64
+
+typedef struct {
+    double* data; // rows * ld doubles, row i starts at data + i * ld
+    int rows;
+    int cols;
+    int ld;       // Leading dimension (row stride in doubles), always >= cols
+} Matrix;
+
+// Pointer to the first element of row i
+#define MATRIX_ROW(m, i) ((m)->data + (size_t)(i) * (m)->ld)
+
+// Element (i, j) of the matrix
+#define MATRIX_AT(m, i, j) (MATRIX_ROW(m, i)[j])
+
+// Function to round a column count up to a whole number of cache lines
+static inline int matrixLeadingDimension(int cols) {
+    int perLine = MATRIX_ALIGNMENT / sizeof(double);
+    return (cols + perLine - 1) / perLine * perLine;
+}
+
+// Function to allocate count doubles on a MATRIX_ALIGNMENT boundary, NULL on failure
+static inline double* allocAligned(size_t count) {
+    void* ptr = NULL;
+    if (count == 0) {
+        count = 1;
+    }
+    if (posix_memalign(&ptr, MATRIX_ALIGNMENT, count * sizeof(double)) != 0) {
+        return NULL;
+    }
+    return (double*)ptr;
+}
+
+// Function to allocate an uninitialised matrix; data is NULL if the allocation failed
+static inline Matrix allocMatrix(int rows, int cols) {
+    Matrix matrix;
+    matrix.rows = rows;
+    matrix.cols = cols;
+    matrix.ld = matrixLeadingDimension(cols);
+    matrix.data = allocAligned((size_t)rows * matrix.ld);
+    return matrix;
+}
+
+// Function to release the storage of a matrix
+static inline void freeMatrix(Matrix* matrix) {
+    free(matrix->data);
+    matrix->data = NULL;
+}
+
+// Function to print a matrix one row per line under a title
+static inline void printMatrix(const char* title, const Matrix* matrix) {
+    printf("%s:\n", title);
+    for (int i = 0; i < matrix->rows; i++) {
+        for (int j = 0; j < matrix->cols; j++) {
+            printf("%f ", MATRIX_AT(matrix, i, j));
+        }
+        printf("\n");
+    }
+    printf("\n");
+}
+
+// Function to split rows into parts contiguous bands; the first rows % parts bands get one extra row
+static inline void rowBand(int rows, int parts, int part, int* begin, int* end) {
+    int base = rows / parts;
+    int extra = rows % parts;
+    *begin = part * base + (part < extra ? part : extra);
+    *end = *begin + base + (part < extra ? 1 : 0);
+}
+
+// Function to fill rows [rowBegin, rowEnd) of a matrix with random values; local element (i, j) holds
+// global element (firstRow + i, firstCol + j), so a process holding a block of a larger matrix
+// generates exactly its share of it
+static inline void fillMatrixBlock(Matrix* matrix, uint64_t key, int rowBegin, int rowEnd, int firstRow, int firstCol) {
+    for (int i = rowBegin; i < rowEnd; i++) {
+        double* row = MATRIX_ROW(matrix, i);
+        for (int j = 0; j < matrix->cols; j++) {
+            row[j] = randomUniform(key, (uint64_t)(firstRow + i), (uint64_t)(firstCol + j));
+        }
+        // Keep the padding at the end of each row zeroed so it is safe to read
+        memset(row + matrix->cols, 0, (matrix->ld - matrix->cols) * sizeof(double));
+    }
+}
+
+// Function to fill rows [rowBegin, rowEnd) of a matrix holding global rows firstRow onwards
+static inline void fillMatrixRows(Matrix* matrix, uint64_t key, int rowBegin, int rowEnd, int firstRow) {
+    fillMatrixBlock(matrix, key, rowBegin, rowEnd, firstRow, 0);
+}
+
+// Function to dynamically allocate a matrix and fill it with the random values of stream key. With
+// OpenMP every thread fills its own rowBand, the partition the kernels use, so each band's pages are
+// first touched (and placed) by the thread that multiplies it.
+static inline Matrix createMatrix(int rows, int cols, uint64_t key) {
+    Matrix matrix = allocMatrix(rows, cols);
+    if (matrix.data == NULL) {
+        return matrix;
+    }
+#ifdef _OPENMP
+    #pragma omp parallel
+    {
+        int rowBegin, rowEnd;
+        rowBand(rows, omp_get_num_threads(), omp_get_thread_num(), &rowBegin, &rowEnd);
+        fillMatrixRows(&matrix, key, rowBegin, rowEnd, 0);
+    }
+#else
+    fillMatrixRows(&matrix, key, 0, rows, 0);
+#endif
+    return matrix;
+}
+
+// Function to dynamically allocate a vector and fill it with random values. Element i is (i, 0) of
+// stream key, so it equals column 0 of a block of vectors made by createMatrix with the same key.
+static inline double* createVector(int size, uint64_t key) {
+    double* vector = allocAligned(size);
+    if (vector == NULL) {
+        return NULL;
+    }
+    for (int i = 0; i < size; i++) {
+        vector[i] = randomUniform(key, (uint64_t)i, 0);
+    }
+    return vector;
+}
+
+#endif // MXV_MATRIX_H
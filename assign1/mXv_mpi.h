@@ -0,0 +1,1216 @@
+/*
+ * Programmer(s) : Syed Saad Ullah Hussaini, K214703 Ali Raza, K213100 Muhammad Sameed
+ * Date: 17 October 2026
+ * Desc: MPI helpers and the distributed execution plan shared by the MPI
+ *       matrix vector multiplication programs. Rows are always split with
+ *       rowBand, so rank r owns a contiguous slab and the first rows % size
+ *       ranks get one extra row.
+ */
+
+#ifndef MXV_MPI_H
+#define MXV_MPI_H
+
+#include <math.h>
+#include <mpi.h>
+#include "mXv_matrix.h"
+#include "mXv_lowp.h"
+#include "mXv_plan.h"
+#include "mXv_output.h"
+#include "mXv_numa.h"
+
+// Where the row slabs of the matrix come from (--distribution=...); pipelined scatters like scatter,
+// but in chunks that are multiplied as they arrive
+typedef enum { DISTRIBUTION_LOCAL = 0, DISTRIBUTION_SCATTER = 1, DISTRIBUTION_PIPELINED = 2 } Distribution;
+
+// Function to set up the OpenMP team of every rank of the hybrid engine (--threads=n ranks x threads).
+// provided is the thread level MPI_Init_thread returned; only the main thread calls MPI, so
+// MPI_THREAD_FUNNELED is enough. The team is pinned (--affinity) inside the CPUs mpirun bound the rank
+// to. Falls back to one thread without OpenMP or without FUNNELED support; returns the team size.
+static inline int setupRankThreads(const Options* options, int provided, int rank) {
+    int threads = options->threads;
+#ifdef _OPENMP
+    if (threads > 1 && provided < MPI_THREAD_FUNNELED) {
+        if (rank == 0) {
+            fprintf(stderr, "Warning: MPI does not support MPI_THREAD_FUNNELED, running one thread per rank.\n");
+        }
+        threads = 1;
+    }
+    omp_set_num_threads(threads);
+    pinThreads(options->affinity);
+#else
+    (void)provided;
+    if (threads > 1 && rank == 0) {
+        fprintf(stderr, "Warning: built without OpenMP, --threads=%d runs one thread per rank.\n", threads);
+    }
+    threads = 1;
+#endif
+    return threads;
+}
+
+// Function to fill the per-rank row counts and first rows of the row split
+static inline void rowCountsAndDispls(int rows, int size, int* counts, int* displs) {
+    for (int r = 0; r < size; r++) {
+        int begin, end;
+        rowBand(rows, size, r, &begin, &end);
+        counts[r] = end - begin;
+        displs[r] = begin;
+    }
+}
+
+// Function to scatter row slabs of rowBytes bytes per (padded) row from root; counts and displs are
+// in rows, one derived datatype per row, so large slabs do not overflow the int counts
+static inline void scatterRows(const void* send, void* recv, int rowBytes, const int* counts, const int* displs,
+                               int root, MPI_Comm comm) {
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Datatype rowType;
+    MPI_Type_contiguous(rowBytes, MPI_BYTE, &rowType);
+    MPI_Type_commit(&rowType);
+    MPI_Scatterv(rank == root ? send : NULL, counts, displs, rowType, recv, counts[rank], rowType, root, comm);
+    MPI_Type_free(&rowType);
+}
+
+// Function to gather row slabs of rowBytes bytes per (padded) row on root, the inverse of scatterRows
+static inline void gatherRows(const void* send, void* recv, int rowBytes, const int* counts, const int* displs,
+                              int root, MPI_Comm comm) {
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Datatype rowType;
+    MPI_Type_contiguous(rowBytes, MPI_BYTE, &rowType);
+    MPI_Type_commit(&rowType);
+    MPI_Gatherv(send, counts[rank], rowType, rank == root ? recv : NULL, counts, displs, rowType, root, comm);
+    MPI_Type_free(&rowType);
+}
+
+// Function to scatter the row slabs of a reduced precision matrix held by root. local must already
+// be allocated with counts[rank] rows; the int8 row scales travel with their rows.
+static inline void scatterLowpRows(const LowpMatrix* matrix, LowpMatrix* local, const int* counts, const int* displs,
+                                   int root, MPI_Comm comm) {
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    scatterRows(matrix->data, local->data, local->ld * lowpElementSize(local->precision), counts, displs, root, comm);
+    if (local->precision == PRECISION_I8) {
+        MPI_Scatterv(rank == root ? matrix->scales : NULL, counts, displs, MPI_DOUBLE, local->scales, counts[rank], MPI_DOUBLE, root, comm);
+    }
+}
+
+// Persistent plan of a distributed y = A * x over row slabs: the partition, the local slab, the local
+// result and the plan of the local multiplication are set up once and reused by every execution
+typedef struct {
+    MPI_Comm comm;
+    int rank;
+    int size;
+    int root;
+    int rows;
+    int cols;
+    int* rowCounts;     // Rows of every rank
+    int* rowDispls;     // First row of every rank
+    Matrix local;       // Row slab of this rank
+    double* localResult;
+    MatvecPlan localPlan;
+    double computeSeconds; // Time this rank spent multiplying its slab since the last rebalance
+    int chunks;         // Pipelined executions: chunks per slab, 0 until createMpiMatvecPipeline
+    int* chunkCounts;   // chunks x size: rows of chunk c of every rank
+    int* chunkDispls;   // chunks x size: global first row of chunk c of every rank
+    MPI_Request* requests; // 2 * chunks: the chunk transfers, then the result gathers
+    MPI_Comm nodeComm;     // Shared node memory (createSharedMpiMatvecPlan only): the ranks of this node
+    MPI_Comm leaderComm;   // The node leaders (node rank 0), MPI_COMM_NULL on the other ranks
+    MPI_Win matrixWindow;  // The slabs of the node, contiguous in node rank order; local points into it
+    MPI_Win vectorWindow;  // The one copy of x of the node, allocated by the leader
+    double* sharedVector;  // x inside vectorWindow; NULL for a plan with private memory
+    int* nodeCounts;       // Leaders: rows of the slab of every node, in leaderComm order
+    int* nodeDispls;       // Leaders: first row of the slab of every node
+} MpiMatvecPlan;
+
+// Function to allocate the slab of this rank, its result and the plan of its multiplication once the
+// row split of a distributed plan is known; returns 0 on success, -1 if this rank ran out of memory
+static inline int allocMpiMatvecSlab(MpiMatvecPlan* plan, MatvecEngine engine, int threads, int tileSize) {
+    int localRows = plan->rowCounts[plan->rank];
+    plan->local = allocMatrix(localRows, plan->cols);
+    plan->localResult = allocAligned(localRows);
+    if (plan->local.data == NULL || plan->localResult == NULL) {
+        return -1;
+    }
+    return createMatvecPlan(&plan->localPlan, engine, localRows, plan->cols, threads, tileSize);
+}
+
+// Function to create a distributed plan; engine, threads and tileSize choose how each rank multiplies its
+// slab (as in createMatvecPlan). Collective over comm; returns 0 on success, -1 if this rank ran out of memory.
+static inline int createMpiMatvecPlan(MpiMatvecPlan* plan, MatvecEngine engine, int rows, int cols, int threads,
+                                      int tileSize, int root, MPI_Comm comm) {
+    memset(plan, 0, sizeof(*plan));
+    plan->comm = comm;
+    plan->root = root;
+    plan->rows = rows;
+    plan->cols = cols;
+    MPI_Comm_rank(comm, &plan->rank);
+    MPI_Comm_size(comm, &plan->size);
+    plan->rowCounts = (int*)malloc(plan->size * sizeof(int));
+    plan->rowDispls = (int*)malloc(plan->size * sizeof(int));
+    if (plan->rowCounts == NULL || plan->rowDispls == NULL) {
+        return -1;
+    }
+    rowCountsAndDispls(rows, plan->size, plan->rowCounts, plan->rowDispls);
+    return allocMpiMatvecSlab(plan, engine, threads, tileSize);
+}
+
+// Function to make the stores of the ranks of a node to a shared window visible to all of them
+static inline void syncSharedWindow(MPI_Win window, MPI_Comm nodeComm) {
+    MPI_Win_sync(window);
+    MPI_Barrier(nodeComm);
+    MPI_Win_sync(window);
+}
+
+// Function to create a distributed plan whose ranks share memory per node: comm is split by node
+// (MPI_Comm_split_type), every node keeps its slabs and a single copy of x in MPI_Win_allocate_shared
+// windows, and x is broadcast only between the node leaders, which write it straight into their node's
+// window. The rows are split in node-major order (nodes by the rank of their leader, then by node
+// rank), so the slabs of a node are contiguous and scatterMpiMatvecPlan sends each node's slabs to its
+// leader in one piece. Root is rank 0 of comm. Collective; returns 0 on success, -1 on allocation failure.
+static inline int createSharedMpiMatvecPlan(MpiMatvecPlan* plan, MatvecEngine engine, int rows, int cols, int threads,
+                                            int tileSize, MPI_Comm comm) {
+    memset(plan, 0, sizeof(*plan));
+    plan->comm = comm;
+    plan->root = 0;
+    plan->rows = rows;
+    plan->cols = cols;
+    MPI_Comm_rank(comm, &plan->rank);
+    MPI_Comm_size(comm, &plan->size);
+    int nodeRank;
+    MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, plan->rank, MPI_INFO_NULL, &plan->nodeComm);
+    MPI_Comm_rank(plan->nodeComm, &nodeRank);
+    MPI_Comm_split(comm, nodeRank == 0 ? 0 : MPI_UNDEFINED, plan->rank, &plan->leaderComm);
+
+    // Position of every rank in node-major order
+    int key[2] = {plan->rank, nodeRank};
+    MPI_Bcast(&key[0], 1, MPI_INT, 0, plan->nodeComm);
+    int* keys = (int*)malloc(2 * (size_t)plan->size * sizeof(int));
+    plan->rowCounts = (int*)malloc(plan->size * sizeof(int));
+    plan->rowDispls = (int*)malloc(plan->size * sizeof(int));
+    if (keys == NULL || plan->rowCounts == NULL || plan->rowDispls == NULL) {
+        free(keys);
+        return -1;
+    }
+    MPI_Allgather(key, 2, MPI_INT, keys, 2, MPI_INT, comm);
+    for (int r = 0; r < plan->size; r++) {
+        int slot = 0;
+        for (int q = 0; q < plan->size; q++) {
+            slot += keys[2 * q] < keys[2 * r] || (keys[2 * q] == keys[2 * r] && keys[2 * q + 1] < keys[2 * r + 1]);
+        }
+        int begin, end;
+        rowBand(rows, plan->size, slot, &begin, &end);
+        plan->rowCounts[r] = end - begin;
+        plan->rowDispls[r] = begin;
+    }
+    free(keys);
+
+    // The windows; passive target access for the whole life of the plan, synchronised with syncSharedWindow
+    int localRows = plan->rowCounts[plan->rank];
+    MPI_Aint bytes;
+    int unit;
+    plan->local.rows = localRows;
+    plan->local.cols = cols;
+    plan->local.ld = matrixLeadingDimension(cols);
+    MPI_Win_allocate_shared((MPI_Aint)localRows * plan->local.ld * sizeof(double), sizeof(double), MPI_INFO_NULL,
+                            plan->nodeComm, &plan->local.data, &plan->matrixWindow);
+    MPI_Win_allocate_shared(nodeRank == 0 ? (MPI_Aint)cols * sizeof(double) : 0, sizeof(double), MPI_INFO_NULL,
+                            plan->nodeComm, &plan->sharedVector, &plan->vectorWindow);
+    MPI_Win_shared_query(plan->vectorWindow, 0, &bytes, &unit, &plan->sharedVector);
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, plan->matrixWindow);
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, plan->vectorWindow);
+
+    // Every leader learns the slab of every node; node rank 0 holds the first rows of its node
+    int nodeRows;
+    MPI_Allreduce(&localRows, &nodeRows, 1, MPI_INT, MPI_SUM, plan->nodeComm);
+    if (plan->leaderComm != MPI_COMM_NULL) {
+        int nodes;
+        MPI_Comm_size(plan->leaderComm, &nodes);
+        plan->nodeCounts = (int*)malloc(nodes * sizeof(int));
+        plan->nodeDispls = (int*)malloc(nodes * sizeof(int));
+        if (plan->nodeCounts == NULL || plan->nodeDispls == NULL) {
+            return -1;
+        }
+        MPI_Allgather(&nodeRows, 1, MPI_INT, plan->nodeCounts, 1, MPI_INT, plan->leaderComm);
+        MPI_Allgather(&plan->rowDispls[plan->rank], 1, MPI_INT, plan->nodeDispls, 1, MPI_INT, plan->leaderComm);
+    }
+
+    plan->localResult = allocAligned(localRows);
+    if (plan->localResult == NULL) {
+        return -1;
+    }
+    return createMatvecPlan(&plan->localPlan, engine, localRows, cols, threads, tileSize);
+}
+
+// Function to hand the plan its matrix: root's full matrix is split into the row slabs once. With shared
+// node memory only the leaders receive, each the slabs of its whole node straight into the window.
+static inline void scatterMpiMatvecPlan(MpiMatvecPlan* plan, const Matrix* matrix) {
+    if (plan->sharedVector != NULL) {
+        if (plan->leaderComm != MPI_COMM_NULL) {
+            MPI_Aint bytes;
+            int unit;
+            double* nodeSlab;
+            MPI_Win_shared_query(plan->matrixWindow, 0, &bytes, &unit, &nodeSlab);
+            scatterRows(plan->rank == plan->root ? matrix->data : NULL, nodeSlab, plan->local.ld * (int)sizeof(double),
+                        plan->nodeCounts, plan->nodeDispls, 0, plan->leaderComm);
+        }
+        syncSharedWindow(plan->matrixWindow, plan->nodeComm);
+        return;
+    }
+    scatterRows(plan->rank == plan->root ? matrix->data : NULL, plan->local.data, plan->local.ld * (int)sizeof(double),
+                plan->rowCounts, plan->rowDispls, plan->root, plan->comm);
+}
+
+// Function to hand the plan its matrix without any transfer: every rank generates its own row slab of
+// the random matrix of stream key, so root needs O(rows) memory instead of O(rows * cols)
+static inline void generateMpiMatvecPlan(MpiMatvecPlan* plan, uint64_t key) {
+    fillMatrixRows(&plan->local, key, 0, plan->local.rows, plan->rowDispls[plan->rank]);
+}
+
+// Function to run the distributed multiplication without collecting it: vector is broadcast from root
+// (every rank passes a buffer of cols doubles) and each rank's rows of A * vector stay in localResult.
+// With shared node memory vector is only read on root and the ranks of a node read the node's copy.
+static inline void computeMpiMatvecPlan(MpiMatvecPlan* plan, double* vector) {
+    double* x = vector;
+    if (plan->sharedVector != NULL) {
+        // Once the node is past the barrier nobody reads the previous x any more
+        MPI_Barrier(plan->nodeComm);
+        if (plan->leaderComm != MPI_COMM_NULL) {
+            if (plan->rank == plan->root) {
+                memcpy(plan->sharedVector, vector, plan->cols * sizeof(double));
+            }
+            MPI_Bcast(plan->sharedVector, plan->cols, MPI_DOUBLE, 0, plan->leaderComm);
+        }
+        syncSharedWindow(plan->vectorWindow, plan->nodeComm);
+        x = plan->sharedVector;
+    } else {
+        MPI_Bcast(vector, plan->cols, MPI_DOUBLE, plan->root, plan->comm);
+    }
+    double start = MPI_Wtime();
+    executeMatvecPlan(&plan->localPlan, &plan->local, x, plan->localResult);
+    plan->computeSeconds += MPI_Wtime() - start;
+}
+
+// Function to execute a distributed plan: like computeMpiMatvecPlan, then root receives result = A * vector
+static inline void executeMpiMatvecPlan(MpiMatvecPlan* plan, double* vector, double* result) {
+    computeMpiMatvecPlan(plan, vector);
+    MPI_Gatherv(plan->localResult, plan->rowCounts[plan->rank], MPI_DOUBLE, result, plan->rowCounts, plan->rowDispls,
+                MPI_DOUBLE, plan->root, plan->comm);
+}
+
+// Function to prepare a distributed plan for pipelined executions: every slab is split into chunks row
+// bands (rowBand again, so chunk sizes differ by at most one row). Returns 0 on success, -1 on allocation failure.
+static inline int createMpiMatvecPipeline(MpiMatvecPlan* plan, int chunks) {
+    plan->chunks = chunks;
+    plan->chunkCounts = (int*)malloc((size_t)chunks * plan->size * sizeof(int));
+    plan->chunkDispls = (int*)malloc((size_t)chunks * plan->size * sizeof(int));
+    plan->requests = (MPI_Request*)malloc(2 * (size_t)chunks * sizeof(MPI_Request));
+    if (plan->chunkCounts == NULL || plan->chunkDispls == NULL || plan->requests == NULL) {
+        return -1;
+    }
+    for (int c = 0; c < chunks; c++) {
+        for (int r = 0; r < plan->size; r++) {
+            int begin, end;
+            rowBand(plan->rowCounts[r], chunks, c, &begin, &end);
+            plan->chunkCounts[c * plan->size + r] = end - begin;
+            plan->chunkDispls[c * plan->size + r] = plan->rowDispls[r] + begin;
+        }
+    }
+    return 0;
+}
+
+// Function to execute a distributed plan as a pipeline of chunks. When matrix is not NULL (on every rank;
+// only root's data is read) chunk c of every slab is sent with its own MPI_Iscatterv, all posted up front
+// next to an MPI_Ibcast of vector, and each chunk is multiplied as soon as it has arrived while the later
+// ones are still in flight. With gather, the rows of every finished chunk go back to root's result with an
+// MPI_Igatherv that proceeds while the next chunk is computed; otherwise they stay in localResult. Once
+// the slabs are resident, pass matrix = NULL and only the vector and the result gathers are overlapped.
+static inline void pipelineMpiMatvecPlan(MpiMatvecPlan* plan, const Matrix* matrix, double* vector, double* result, int gather) {
+    int size = plan->size;
+    MPI_Request* transfers = plan->requests;
+    MPI_Request* gathers = plan->requests + plan->chunks;
+    MPI_Request vectorRequest;
+    MPI_Ibcast(vector, plan->cols, MPI_DOUBLE, plan->root, plan->comm, &vectorRequest);
+
+    MPI_Datatype rowType = MPI_DATATYPE_NULL;
+    if (matrix != NULL) {
+        MPI_Type_contiguous(plan->local.ld * (int)sizeof(double), MPI_BYTE, &rowType);
+        MPI_Type_commit(&rowType);
+        for (int c = 0; c < plan->chunks; c++) {
+            int first = plan->chunkDispls[c * size + plan->rank] - plan->rowDispls[plan->rank];
+            MPI_Iscatterv(plan->rank == plan->root ? matrix->data : NULL, &plan->chunkCounts[c * size],
+                          &plan->chunkDispls[c * size], rowType, MATRIX_ROW(&plan->local, first),
+                          plan->chunkCounts[c * size + plan->rank], rowType, plan->root, plan->comm, &transfers[c]);
+        }
+    }
+    MPI_Wait(&vectorRequest, MPI_STATUS_IGNORE);
+
+    for (int c = 0; c < plan->chunks; c++) {
+        if (matrix != NULL) {
+            MPI_Wait(&transfers[c], MPI_STATUS_IGNORE);
+        }
+        int first = plan->chunkDispls[c * size + plan->rank] - plan->rowDispls[plan->rank];
+        int count = plan->chunkCounts[c * size + plan->rank];
+        double start = MPI_Wtime();
+        executeMatvecRows(&plan->localPlan, &plan->local, vector, plan->localResult, first, first + count);
+        plan->computeSeconds += MPI_Wtime() - start;
+        if (gather) {
+            MPI_Igatherv(plan->localResult + first, count, MPI_DOUBLE, result, &plan->chunkCounts[c * size],
+                         &plan->chunkDispls[c * size], MPI_DOUBLE, plan->root, plan->comm, &gathers[c]);
+        }
+    }
+    if (gather) {
+        MPI_Waitall(plan->chunks, gathers, MPI_STATUSES_IGNORE);
+    }
+    if (rowType != MPI_DATATYPE_NULL) {
+        MPI_Type_free(&rowType);
+    }
+}
+
+// Rows times columns of the matrix every rank multiplies to calibrate its speed
+#define CALIBRATION_ELEMENTS (1 << 18)
+
+// Shortest time the calibration multiplies for, so timer resolution and noise do not dominate
+#define CALIBRATION_SECONDS 0.02
+
+// Function to measure how many rows of cols columns per second this rank multiplies with the given
+// engine: a small random matrix of about CALIBRATION_ELEMENTS elements is multiplied for at least
+// CALIBRATION_SECONDS after one warm-up run. Returns 0 if the calibration data could not be allocated.
+static inline double calibrateRowRate(MatvecEngine engine, int cols, int threads, int tileSize) {
+    int rows = CALIBRATION_ELEMENTS / cols;
+    rows = rows < 16 ? 16 : rows;
+    Matrix matrix = createMatrix(rows, cols, randomKey(RANDOM_DEFAULT_SEED, RANDOM_STREAM_MATRIX));
+    double* vector = createVector(cols, randomKey(RANDOM_DEFAULT_SEED, RANDOM_STREAM_VECTOR));
+    double* result = allocAligned(rows);
+    MatvecPlan plan = {0}; // Safe to destroy even when an allocation failed before the plan was created
+    double rate = 0.0;
+    if (matrix.data != NULL && vector != NULL && result != NULL &&
+        createMatvecPlan(&plan, engine, rows, cols, threads, tileSize) == 0) {
+        executeMatvecPlan(&plan, &matrix, vector, result);
+        int runs = 0;
+        double seconds = 0.0;
+        double start = MPI_Wtime();
+        while (runs < 2 || seconds < CALIBRATION_SECONDS) {
+            executeMatvecPlan(&plan, &matrix, vector, result);
+            runs++;
+            seconds = MPI_Wtime() - start;
+        }
+        rate = (double)rows * runs / seconds;
+    }
+    destroyMatvecPlan(&plan);
+    freeMatrix(&matrix);
+    free(vector);
+    free(result);
+    return rate;
+}
+
+// Function to split rows over size ranks in proportion to their weights (rows per second): every rank
+// gets the floor of its share and the leftover rows go to the largest remainders. Falls back to the
+// even split when a weight is not positive.
+static inline void weightedRowCounts(int rows, int size, const double* weights, int* counts, int* displs) {
+    double total = 0.0;
+    for (int r = 0; r < size; r++) {
+        if (!(weights[r] > 0.0)) {
+            rowCountsAndDispls(rows, size, counts, displs);
+            return;
+        }
+        total += weights[r];
+    }
+    int assigned = 0;
+    for (int r = 0; r < size; r++) {
+        counts[r] = (int)(rows * (weights[r] / total));
+        assigned += counts[r];
+    }
+    for (; assigned < rows; assigned++) {
+        int best = 0;
+        double bestRemainder = -1.0;
+        for (int r = 0; r < size; r++) {
+            double remainder = rows * (weights[r] / total) - counts[r];
+            if (remainder > bestRemainder) {
+                best = r;
+                bestRemainder = remainder;
+            }
+        }
+        counts[best]++;
+    }
+    for (int r = 0, first = 0; r < size; r++) {
+        displs[r] = first;
+        first += counts[r];
+    }
+}
+
+// Function to create a distributed plan for ranks of different speed: every rank first calibrates its
+// rows per second (calibrateRowRate) and the rows are split in proportion, so the slowest rank no longer
+// sets the time of every execution. Same arguments and result as createMpiMatvecPlan.
+static inline int createWeightedMpiMatvecPlan(MpiMatvecPlan* plan, MatvecEngine engine, int rows, int cols, int threads,
+                                              int tileSize, int root, MPI_Comm comm) {
+    memset(plan, 0, sizeof(*plan));
+    plan->comm = comm;
+    plan->root = root;
+    plan->rows = rows;
+    plan->cols = cols;
+    MPI_Comm_rank(comm, &plan->rank);
+    MPI_Comm_size(comm, &plan->size);
+    plan->rowCounts = (int*)malloc(plan->size * sizeof(int));
+    plan->rowDispls = (int*)malloc(plan->size * sizeof(int));
+    double* rates = (double*)malloc(plan->size * sizeof(double));
+    if (plan->rowCounts == NULL || plan->rowDispls == NULL || rates == NULL) {
+        free(rates);
+        return -1;
+    }
+    double rate = calibrateRowRate(engine, cols, threads, tileSize);
+    MPI_Allgather(&rate, 1, MPI_DOUBLE, rates, 1, MPI_DOUBLE, comm);
+    weightedRowCounts(rows, plan->size, rates, plan->rowCounts, plan->rowDispls);
+    free(rates);
+    return allocMpiMatvecSlab(plan, engine, threads, tileSize);
+}
+
+// Function to move rows between the ranks of a plan so that rank r owns newCounts[r] rows from
+// newDispls[r] on. Rows keep their global order, so results do not change; every rank sends the part of
+// its slab that belongs to another rank with one MPI_Alltoallv. Collective; returns 0 on success, -1 if
+// this rank ran out of memory.
+static inline int repartitionMpiMatvecPlan(MpiMatvecPlan* plan, const int* newCounts, const int* newDispls) {
+    int size = plan->size;
+    int* transfer = (int*)malloc(4 * (size_t)size * sizeof(int));
+    Matrix local = allocMatrix(newCounts[plan->rank], plan->cols);
+    double* localResult = allocAligned(newCounts[plan->rank]);
+    if (transfer == NULL || local.data == NULL || localResult == NULL) {
+        free(transfer);
+        freeMatrix(&local);
+        free(localResult);
+        return -1;
+    }
+    int* sendCounts = transfer;
+    int* sendDispls = transfer + size;
+    int* recvCounts = transfer + 2 * size;
+    int* recvDispls = transfer + 3 * size;
+    int oldBegin = plan->rowDispls[plan->rank];
+    int oldEnd = oldBegin + plan->rowCounts[plan->rank];
+    int newBegin = newDispls[plan->rank];
+    int newEnd = newBegin + newCounts[plan->rank];
+    for (int r = 0; r < size; r++) {
+        // The rows of my old slab that r owns from now on, and the rows of r's old slab that I own
+        int begin = oldBegin > newDispls[r] ? oldBegin : newDispls[r];
+        int end = oldEnd < newDispls[r] + newCounts[r] ? oldEnd : newDispls[r] + newCounts[r];
+        sendCounts[r] = end > begin ? end - begin : 0;
+        sendDispls[r] = end > begin ? begin - oldBegin : 0;
+        begin = newBegin > plan->rowDispls[r] ? newBegin : plan->rowDispls[r];
+        end = newEnd < plan->rowDispls[r] + plan->rowCounts[r] ? newEnd : plan->rowDispls[r] + plan->rowCounts[r];
+        recvCounts[r] = end > begin ? end - begin : 0;
+        recvDispls[r] = end > begin ? begin - newBegin : 0;
+    }
+    MPI_Datatype rowType;
+    MPI_Type_contiguous(plan->local.ld * (int)sizeof(double), MPI_BYTE, &rowType);
+    MPI_Type_commit(&rowType);
+    MPI_Alltoallv(plan->local.data, sendCounts, sendDispls, rowType, local.data, recvCounts, recvDispls, rowType, plan->comm);
+    MPI_Type_free(&rowType);
+    free(transfer);
+
+    // The local multiplication is planned again for the new slab height
+    MatvecPlan localPlan;
+    if (createMatvecPlan(&localPlan, plan->localPlan.engine, local.rows, plan->cols, plan->localPlan.threads,
+                         plan->localPlan.tileCols) != 0) {
+        freeMatrix(&local);
+        free(localResult);
+        return -1;
+    }
+    destroyMatvecPlan(&plan->localPlan);
+    freeMatrix(&plan->local);
+    free(plan->localResult);
+    plan->localPlan = localPlan;
+    plan->local = local;
+    plan->localResult = localResult;
+    memcpy(plan->rowCounts, newCounts, size * sizeof(int));
+    memcpy(plan->rowDispls, newDispls, size * sizeof(int));
+    if (plan->chunks > 0) {
+        int chunks = plan->chunks;
+        free(plan->chunkCounts);
+        free(plan->chunkDispls);
+        free(plan->requests);
+        return createMpiMatvecPipeline(plan, chunks);
+    }
+    return 0;
+}
+
+// Function to rebalance a plan from the compute time its ranks measured since the last rebalance
+// (computeSeconds): the rows are split again in proportion to each rank's observed rows per second
+// and moved if that shortens the slowest rank by more than 5%. Collective; returns 1 if rows were
+// moved, 0 if not, -1 on allocation failure.
+static inline int rebalanceMpiMatvecPlan(MpiMatvecPlan* plan) {
+    int size = plan->size;
+    double* rates = (double*)malloc(size * sizeof(double));
+    int* counts = (int*)malloc(2 * (size_t)size * sizeof(int));
+    if (rates == NULL || counts == NULL) {
+        free(rates);
+        free(counts);
+        return -1;
+    }
+    double seconds = plan->computeSeconds > 1e-9 ? plan->computeSeconds : 1e-9;
+    double rate = plan->rowCounts[plan->rank] > 0 ? plan->rowCounts[plan->rank] / seconds : 0.0;
+    MPI_Allgather(&rate, 1, MPI_DOUBLE, rates, 1, MPI_DOUBLE, plan->comm);
+    plan->computeSeconds = 0.0;
+
+    // A rank without rows has no observed rate; keep its old share by giving it the mean rate
+    double mean = 0.0;
+    int measured = 0;
+    for (int r = 0; r < size; r++) {
+        if (rates[r] > 0.0) {
+            mean += rates[r];
+            measured++;
+        }
+    }
+    mean = measured > 0 ? mean / measured : 1.0;
+    double oldTime = 0.0, newTime = 0.0;
+    for (int r = 0; r < size; r++) {
+        rates[r] = rates[r] > 0.0 ? rates[r] : mean;
+    }
+    weightedRowCounts(plan->rows, size, rates, counts, counts + size);
+    for (int r = 0; r < size; r++) {
+        double oldRank = plan->rowCounts[r] / rates[r];
+        double newRank = counts[r] / rates[r];
+        oldTime = oldRank > oldTime ? oldRank : oldTime;
+        newTime = newRank > newTime ? newRank : newTime;
+    }
+    int status = 0;
+    if (newTime < 0.95 * oldTime) {
+        status = repartitionMpiMatvecPlan(plan, counts, counts + size);
+        status = status == 0 ? 1 : -1;
+    }
+    free(rates);
+    free(counts);
+    return status;
+}
+
+// Function to print on standard error (root only) how many rows every rank of a plan owns
+static inline void printRowPartition(const MpiMatvecPlan* plan, const char* title) {
+    if (plan->rank != plan->root) {
+        return;
+    }
+    fprintf(stderr, "%s:", title);
+    for (int r = 0; r < plan->size; r++) {
+        fprintf(stderr, " %d", plan->rowCounts[r]);
+    }
+    fprintf(stderr, "\n");
+}
+
+// Function to scale the values of a distributed vector piece to unit 2-norm of the whole vector; squares
+// is the sum of squares of the whole vector. Returns its norm (the piece is left alone if it is 0).
+static inline double normalizePiece(double* piece, int count, double squares) {
+    double norm = sqrt(squares);
+    if (norm > 0.0) {
+        for (int i = 0; i < count; i++) {
+            piece[i] /= norm;
+        }
+    }
+    return norm;
+}
+
+// Function to get the sum of squares of count values
+static inline double sumOfSquares(const double* values, int count) {
+    double squares = 0.0;
+    for (int i = 0; i < count; i++) {
+        squares += values[i] * values[i];
+    }
+    return squares;
+}
+
+// Function to run iterations steps of the power iteration x <- A x / ||A x|| on a square distributed
+// plan with the matrix resident. vector holds the start vector on root and must have room for cols
+// doubles on every rank; on return it holds the last x on every rank (each rank's rows of it also stay
+// in localResult). Every step redistributes the new x with MPI_Allgatherv and reduces its norm with
+// MPI_Allreduce instead of a gather to root and a broadcast back; with an MPI-4 library both are
+// persistent collectives set up once and only started per step. Returns ||A x|| of the last step, the
+// estimate of the magnitude of the dominant eigenvalue.
+static inline double powerIterationMpiMatvecPlan(MpiMatvecPlan* plan, double* vector, int iterations) {
+    int localRows = plan->rowCounts[plan->rank];
+    MPI_Bcast(vector, plan->cols, MPI_DOUBLE, plan->root, plan->comm);
+    normalizePiece(vector, plan->cols, sumOfSquares(vector, plan->cols)); // Same on every rank
+
+    double squares, totalSquares, norm = 0.0;
+#if MPI_VERSION >= 4
+    MPI_Request requests[2];
+    MPI_Allreduce_init(&squares, &totalSquares, 1, MPI_DOUBLE, MPI_SUM, plan->comm, MPI_INFO_NULL, &requests[0]);
+    MPI_Allgatherv_init(plan->localResult, localRows, MPI_DOUBLE, vector, plan->rowCounts, plan->rowDispls, MPI_DOUBLE,
+                        plan->comm, MPI_INFO_NULL, &requests[1]);
+#endif
+    for (int step = 0; step < iterations; step++) {
+        executeMatvecPlan(&plan->localPlan, &plan->local, vector, plan->localResult);
+        squares = sumOfSquares(plan->localResult, localRows);
+#if MPI_VERSION >= 4
+        MPI_Start(&requests[0]);
+        MPI_Wait(&requests[0], MPI_STATUS_IGNORE);
+#else
+        MPI_Allreduce(&squares, &totalSquares, 1, MPI_DOUBLE, MPI_SUM, plan->comm);
+#endif
+        norm = normalizePiece(plan->localResult, localRows, totalSquares);
+#if MPI_VERSION >= 4
+        MPI_Start(&requests[1]);
+        MPI_Wait(&requests[1], MPI_STATUS_IGNORE);
+#else
+        MPI_Allgatherv(plan->localResult, localRows, MPI_DOUBLE, vector, plan->rowCounts, plan->rowDispls, MPI_DOUBLE,
+                       plan->comm);
+#endif
+    }
+#if MPI_VERSION >= 4
+    MPI_Request_free(&requests[0]);
+    MPI_Request_free(&requests[1]);
+#endif
+    return norm;
+}
+
+// Function to release everything a distributed plan owns
+static inline void destroyMpiMatvecPlan(MpiMatvecPlan* plan) {
+    free(plan->chunkCounts);
+    free(plan->chunkDispls);
+    free(plan->requests);
+    plan->chunkCounts = NULL;
+    plan->chunkDispls = NULL;
+    plan->requests = NULL;
+    if (plan->sharedVector != NULL) {
+        MPI_Win_unlock_all(plan->matrixWindow);
+        MPI_Win_unlock_all(plan->vectorWindow);
+        MPI_Win_free(&plan->matrixWindow);
+        MPI_Win_free(&plan->vectorWindow);
+        plan->local.data = NULL; // It was the window memory
+        plan->sharedVector = NULL;
+        free(plan->nodeCounts);
+        free(plan->nodeDispls);
+        plan->nodeCounts = NULL;
+        plan->nodeDispls = NULL;
+        if (plan->leaderComm != MPI_COMM_NULL) {
+            MPI_Comm_free(&plan->leaderComm);
+        }
+        MPI_Comm_free(&plan->nodeComm);
+    }
+    destroyMatvecPlan(&plan->localPlan);
+    freeMatrix(&plan->local);
+    free(plan->localResult);
+    free(plan->rowCounts);
+    free(plan->rowDispls);
+    plan->localResult = NULL;
+    plan->rowCounts = NULL;
+    plan->rowDispls = NULL;
+}
+
+// Persistent plan of y = A * x on a 2D process grid. The ranks form a gridRows x gridCols grid
+// (as square as MPI_Dims_create makes it, rank = gridRow * gridCols + gridCol) and rank (r, c) owns
+// the block of A at row band r and column band c. Each execution sends rank (r, c) only slice c of x
+// (scattered along grid row 0, then broadcast down the column communicator) and sums the partial
+// products of a grid row with MPI_Reduce_scatter over the row communicator, which leaves every rank
+// one contiguous piece of y. Compared with a 1D row split, a rank receives about cols / sqrt(p)
+// values of x instead of cols. Root is rank 0 of comm, grid position (0, 0).
+typedef struct {
+    MPI_Comm comm;
+    MPI_Comm rowComm;   // Ranks of the same grid row, ordered by grid column
+    MPI_Comm colComm;   // Ranks of the same grid column, ordered by grid row
+    int rank;
+    int size;
+    int gridRows;
+    int gridCols;
+    int gridRow;
+    int gridCol;
+    int rows;
+    int cols;
+    int rowBegin;       // First global row of the local block
+    int colBegin;       // First global column of the local block
+    Matrix local;       // Block of A owned by this rank
+    double* slice;      // The local.cols values of x matching the block
+    double* partial;    // local.rows partial sums of y over this block's columns
+    double* piece;      // This rank's piece of y after the reduction, pieceCounts[gridCol] values
+    int* pieceCounts;   // Piece sizes of the ranks of rowComm
+    int* sliceCounts;   // Column band sizes of the ranks of rowComm, for scattering x
+    int* sliceDispls;
+    int* resultCounts;  // Piece sizes of all ranks of comm, for gathering y
+    int* resultDispls;  // Global first row of every rank's piece
+    MatvecPlan localPlan;
+    int chunks;         // Pipelined scatter: chunks per block, 0 until createMpiGridPipeline
+    MPI_Request* requests; // The chunk receives, then on rank 0 the chunks x size chunk sends
+} MpiGridPlan;
+
+// Function to create a 2D grid plan; engine, threads and tileSize choose how each rank multiplies its
+// block. Collective over comm; returns 0 on success, -1 if this rank ran out of memory.
+static inline int createMpiGridPlan(MpiGridPlan* plan, MatvecEngine engine, int rows, int cols, int threads, int tileSize,
+                                    MPI_Comm comm) {
+    memset(plan, 0, sizeof(*plan));
+    plan->comm = comm;
+    plan->rows = rows;
+    plan->cols = cols;
+    MPI_Comm_rank(comm, &plan->rank);
+    MPI_Comm_size(comm, &plan->size);
+    int dims[2] = {0, 0};
+    MPI_Dims_create(plan->size, 2, dims);
+    plan->gridRows = dims[0];
+    plan->gridCols = dims[1];
+    plan->gridRow = plan->rank / plan->gridCols;
+    plan->gridCol = plan->rank % plan->gridCols;
+    MPI_Comm_split(comm, plan->gridRow, plan->gridCol, &plan->rowComm);
+    MPI_Comm_split(comm, plan->gridCol, plan->gridRow, &plan->colComm);
+
+    int rowEnd, colEnd;
+    rowBand(rows, plan->gridRows, plan->gridRow, &plan->rowBegin, &rowEnd);
+    rowBand(cols, plan->gridCols, plan->gridCol, &plan->colBegin, &colEnd);
+    int blockRows = rowEnd - plan->rowBegin;
+
+    plan->pieceCounts = (int*)malloc(plan->gridCols * sizeof(int));
+    plan->sliceCounts = (int*)malloc(plan->gridCols * sizeof(int));
+    plan->sliceDispls = (int*)malloc(plan->gridCols * sizeof(int));
+    plan->resultCounts = (int*)malloc(plan->size * sizeof(int));
+    plan->resultDispls = (int*)malloc(plan->size * sizeof(int));
+    if (plan->pieceCounts == NULL || plan->sliceCounts == NULL || plan->sliceDispls == NULL ||
+        plan->resultCounts == NULL || plan->resultDispls == NULL) {
+        return -1;
+    }
+    rowCountsAndDispls(cols, plan->gridCols, plan->sliceCounts, plan->sliceDispls);
+    for (int c = 0; c < plan->gridCols; c++) {
+        int begin, end;
+        rowBand(blockRows, plan->gridCols, c, &begin, &end);
+        plan->pieceCounts[c] = end - begin;
+    }
+    // Rank (r, c) ends up with piece c of row band r
+    for (int r = 0; r < plan->gridRows; r++) {
+        int bandBegin, bandEnd;
+        rowBand(rows, plan->gridRows, r, &bandBegin, &bandEnd);
+        for (int c = 0; c < plan->gridCols; c++) {
+            int begin, end;
+            rowBand(bandEnd - bandBegin, plan->gridCols, c, &begin, &end);
+            plan->resultCounts[r * plan->gridCols + c] = end - begin;
+            plan->resultDispls[r * plan->gridCols + c] = bandBegin + begin;
+        }
+    }
+
+    plan->local = allocMatrix(blockRows, colEnd - plan->colBegin);
+    plan->slice = allocAligned(plan->local.cols);
+    plan->partial = allocAligned(blockRows);
+    plan->piece = allocAligned(plan->pieceCounts[plan->gridCol]);
+    if (plan->local.data == NULL || plan->slice == NULL || plan->partial == NULL || plan->piece == NULL) {
+        return -1;
+    }
+    return createMatvecPlan(&plan->localPlan, engine, blockRows, plan->local.cols, threads, tileSize);
+}
+
+// Function to hand the grid plan its matrix without any transfer: every rank generates its own block
+static inline void generateMpiGridPlan(MpiGridPlan* plan, uint64_t key) {
+    fillMatrixBlock(&plan->local, key, 0, plan->local.rows, plan->rowBegin, plan->colBegin);
+}
+
+// Function to hand the grid plan its matrix from root's full matrix: every block goes out once as a
+// strided datatype, so root never packs a copy
+static inline void scatterMpiGridPlan(MpiGridPlan* plan, const Matrix* matrix) {
+    MPI_Request request;
+    MPI_Datatype localType;
+    MPI_Type_vector(plan->local.rows, plan->local.cols, plan->local.ld, MPI_DOUBLE, &localType);
+    MPI_Type_commit(&localType);
+    MPI_Irecv(plan->local.data, 1, localType, 0, 0, plan->comm, &request);
+    if (plan->rank == 0) {
+        for (int dest = 0; dest < plan->size; dest++) {
+            int rowBegin, rowEnd, colBegin, colEnd;
+            rowBand(plan->rows, plan->gridRows, dest / plan->gridCols, &rowBegin, &rowEnd);
+            rowBand(plan->cols, plan->gridCols, dest % plan->gridCols, &colBegin, &colEnd);
+            MPI_Datatype blockType;
+            MPI_Type_vector(rowEnd - rowBegin, colEnd - colBegin, matrix->ld, MPI_DOUBLE, &blockType);
+            MPI_Type_commit(&blockType);
+            MPI_Send(&MATRIX_AT(matrix, rowBegin, colBegin), 1, blockType, dest, 0, plan->comm);
+            MPI_Type_free(&blockType);
+        }
+    }
+    MPI_Wait(&request, MPI_STATUS_IGNORE);
+    MPI_Type_free(&localType);
+    // The receive only wrote the block itself, the row padding is still to be cleared
+    for (int i = 0; i < plan->local.rows; i++) {
+        memset(MATRIX_ROW(&plan->local, i) + plan->local.cols, 0, (plan->local.ld - plan->local.cols) * sizeof(double));
+    }
+}
+
+// Function to run the grid multiplication without collecting it: vector is only read on root, and every
+// rank is left with its piece of y in piece (rows resultDispls[rank] onwards)
+static inline void computeMpiGridPlan(const MpiGridPlan* plan, const double* vector) {
+    if (plan->gridRow == 0) {
+        MPI_Scatterv(vector, plan->sliceCounts, plan->sliceDispls, MPI_DOUBLE, plan->slice, plan->local.cols, MPI_DOUBLE, 0,
+                     plan->rowComm);
+    }
+    MPI_Bcast(plan->slice, plan->local.cols, MPI_DOUBLE, 0, plan->colComm);
+    executeMatvecPlan(&plan->localPlan, &plan->local, plan->slice, plan->partial);
+    MPI_Reduce_scatter(plan->partial, plan->piece, plan->pieceCounts, MPI_DOUBLE, MPI_SUM, plan->rowComm);
+}
+
+// Function to execute a grid plan: like computeMpiGridPlan, then root receives result = A * vector
+static inline void executeMpiGridPlan(const MpiGridPlan* plan, const double* vector, double* result) {
+    computeMpiGridPlan(plan, vector);
+    MPI_Gatherv(plan->piece, plan->resultCounts[plan->rank], MPI_DOUBLE, result, plan->resultCounts, plan->resultDispls,
+                MPI_DOUBLE, 0, plan->comm);
+}
+
+// Function to run iterations steps of the power iteration on a square grid plan, like
+// powerIterationMpiMatvecPlan: vector (cols doubles on every rank, the start vector on root) holds the
+// last x on every rank on return and each rank's piece of it stays in piece. Every step multiplies the
+// block by its slice of x, reduces the partial sums along the grid row, normalises with MPI_Allreduce
+// and collects the pieces into x with MPI_Allgatherv, as MPI-4 persistent collectives when available.
+static inline double powerIterationMpiGridPlan(MpiGridPlan* plan, double* vector, int iterations) {
+    int pieceRows = plan->resultCounts[plan->rank];
+    MPI_Bcast(vector, plan->cols, MPI_DOUBLE, 0, plan->comm);
+    normalizePiece(vector, plan->cols, sumOfSquares(vector, plan->cols));
+
+    double squares, totalSquares, norm = 0.0;
+#if MPI_VERSION >= 4
+    MPI_Request requests[3];
+    MPI_Reduce_scatter_init(plan->partial, plan->piece, plan->pieceCounts, MPI_DOUBLE, MPI_SUM, plan->rowComm,
+                            MPI_INFO_NULL, &requests[0]);
+    MPI_Allreduce_init(&squares, &totalSquares, 1, MPI_DOUBLE, MPI_SUM, plan->comm, MPI_INFO_NULL, &requests[1]);
+    MPI_Allgatherv_init(plan->piece, pieceRows, MPI_DOUBLE, vector, plan->resultCounts, plan->resultDispls, MPI_DOUBLE,
+                        plan->comm, MPI_INFO_NULL, &requests[2]);
+#endif
+    for (int step = 0; step < iterations; step++) {
+        memcpy(plan->slice, vector + plan->colBegin, plan->local.cols * sizeof(double));
+        executeMatvecPlan(&plan->localPlan, &plan->local, plan->slice, plan->partial);
+#if MPI_VERSION >= 4
+        MPI_Start(&requests[0]);
+        MPI_Wait(&requests[0], MPI_STATUS_IGNORE);
+        squares = sumOfSquares(plan->piece, pieceRows);
+        MPI_Start(&requests[1]);
+        MPI_Wait(&requests[1], MPI_STATUS_IGNORE);
+        norm = normalizePiece(plan->piece, pieceRows, totalSquares);
+        MPI_Start(&requests[2]);
+        MPI_Wait(&requests[2], MPI_STATUS_IGNORE);
+#else
+        MPI_Reduce_scatter(plan->partial, plan->piece, plan->pieceCounts, MPI_DOUBLE, MPI_SUM, plan->rowComm);
+        squares = sumOfSquares(plan->piece, pieceRows);
+        MPI_Allreduce(&squares, &totalSquares, 1, MPI_DOUBLE, MPI_SUM, plan->comm);
+        norm = normalizePiece(plan->piece, pieceRows, totalSquares);
+        MPI_Allgatherv(plan->piece, pieceRows, MPI_DOUBLE, vector, plan->resultCounts, plan->resultDispls, MPI_DOUBLE,
+                       plan->comm);
+#endif
+    }
+#if MPI_VERSION >= 4
+    for (int i = 0; i < 3; i++) {
+        MPI_Request_free(&requests[i]);
+    }
+#endif
+    return norm;
+}
+
+// Function to prepare a grid plan for a pipelined scatter with chunks row chunks per block.
+// Returns 0 on success, -1 on allocation failure.
+static inline int createMpiGridPipeline(MpiGridPlan* plan, int chunks) {
+    plan->chunks = chunks;
+    size_t requests = (size_t)chunks * (plan->rank == 0 ? 1 + plan->size : 1);
+    plan->requests = (MPI_Request*)malloc(requests * sizeof(MPI_Request));
+    return plan->requests == NULL ? -1 : 0;
+}
+
+// Function to post the transfer of row chunk c of the block of rank dest (rank 0 only)
+static inline void sendMpiGridChunk(const MpiGridPlan* plan, const Matrix* matrix, int dest, int c, MPI_Request* request) {
+    int rowBegin, rowEnd, colBegin, colEnd, begin, end;
+    rowBand(plan->rows, plan->gridRows, dest / plan->gridCols, &rowBegin, &rowEnd);
+    rowBand(plan->cols, plan->gridCols, dest % plan->gridCols, &colBegin, &colEnd);
+    rowBand(rowEnd - rowBegin, plan->chunks, c, &begin, &end);
+    MPI_Datatype chunkType;
+    MPI_Type_vector(end - begin, colEnd - colBegin, matrix->ld, MPI_DOUBLE, &chunkType);
+    MPI_Type_commit(&chunkType);
+    MPI_Isend(&MATRIX_AT(matrix, rowBegin + begin, colBegin), 1, chunkType, dest, c, plan->comm, request);
+    MPI_Type_free(&chunkType); // Freeing only marks it, the pending send still completes
+}
+
+// Function to hand the grid plan its matrix and run the first multiplication as a pipeline: every block
+// travels from rank 0 as row chunks (all posted up front, chunk c of every rank before chunk c + 1) and
+// each chunk is multiplied as soon as it has arrived while the later ones are still in flight. The
+// partial sums are then reduced like computeMpiGridPlan and, with gather, collected on root's result.
+static inline void pipelineMpiGridPlan(MpiGridPlan* plan, const Matrix* matrix, const double* vector, double* result,
+                                       int gather) {
+    MPI_Request* receives = plan->requests;
+    for (int c = 0; c < plan->chunks; c++) {
+        int begin, end;
+        rowBand(plan->local.rows, plan->chunks, c, &begin, &end);
+        MPI_Datatype chunkType;
+        MPI_Type_vector(end - begin, plan->local.cols, plan->local.ld, MPI_DOUBLE, &chunkType);
+        MPI_Type_commit(&chunkType);
+        MPI_Irecv(MATRIX_ROW(&plan->local, begin), 1, chunkType, 0, c, plan->comm, &receives[c]);
+        MPI_Type_free(&chunkType);
+    }
+    if (plan->rank == 0) {
+        for (int c = 0; c < plan->chunks; c++) {
+            for (int dest = 0; dest < plan->size; dest++) {
+                sendMpiGridChunk(plan, matrix, dest, c, &plan->requests[plan->chunks + c * plan->size + dest]);
+            }
+        }
+    }
+
+    // The slice of x is needed by the first chunk already; the matrix chunks keep flowing meanwhile
+    if (plan->gridRow == 0) {
+        MPI_Scatterv(vector, plan->sliceCounts, plan->sliceDispls, MPI_DOUBLE, plan->slice, plan->local.cols, MPI_DOUBLE, 0,
+                     plan->rowComm);
+    }
+    MPI_Bcast(plan->slice, plan->local.cols, MPI_DOUBLE, 0, plan->colComm);
+
+    for (int c = 0; c < plan->chunks; c++) {
+        int begin, end;
+        rowBand(plan->local.rows, plan->chunks, c, &begin, &end);
+        MPI_Wait(&receives[c], MPI_STATUS_IGNORE);
+        for (int i = begin; i < end; i++) {
+            memset(MATRIX_ROW(&plan->local, i) + plan->local.cols, 0, (plan->local.ld - plan->local.cols) * sizeof(double));
+        }
+        executeMatvecRows(&plan->localPlan, &plan->local, plan->slice, plan->partial, begin, end);
+    }
+    if (plan->rank == 0) {
+        MPI_Waitall(plan->chunks * plan->size, plan->requests + plan->chunks, MPI_STATUSES_IGNORE);
+    }
+    MPI_Reduce_scatter(plan->partial, plan->piece, plan->pieceCounts, MPI_DOUBLE, MPI_SUM, plan->rowComm);
+    if (gather) {
+        MPI_Gatherv(plan->piece, plan->resultCounts[plan->rank], MPI_DOUBLE, result, plan->resultCounts, plan->resultDispls,
+                    MPI_DOUBLE, 0, plan->comm);
+    }
+}
+
+// Function to release everything a grid plan owns
+static inline void destroyMpiGridPlan(MpiGridPlan* plan) {
+    free(plan->requests);
+    plan->requests = NULL;
+    destroyMatvecPlan(&plan->localPlan);
+    freeMatrix(&plan->local);
+    free(plan->slice);
+    free(plan->partial);
+    free(plan->piece);
+    free(plan->pieceCounts);
+    free(plan->sliceCounts);
+    free(plan->sliceDispls);
+    free(plan->resultCounts);
+    free(plan->resultDispls);
+    MPI_Comm_free(&plan->rowComm);
+    MPI_Comm_free(&plan->colComm);
+}
+
+// Function to check that --input is only combined with the dense engine it feeds: the file replaces
+// both the random matrix and its distribution. Prints an error on root and returns -1 otherwise.
+static inline int checkInputOptions(const Options* options, int rank) {
+    if (options->inputFile != NULL && (options->sparse != 0 || options->vectors > 1 || options->precision != 0 ||
+                                       options->distribution != DISTRIBUTION_LOCAL)) {
+        if (rank == 0) {
+            fprintf(stderr, "Error: --input reads a dense double matrix and cannot be combined with --sparse, --vectors, "
+                            "--precision or --distribution.\n");
+        }
+        return -1;
+    }
+    return 0;
+}
+
+// Function to check that --power-iterations is asked for on a square dense matrix whose slabs are in
+// place before the first step (so not streamed by the pipelined distribution). Prints an error on root
+// and returns -1 otherwise.
+static inline int checkPowerIterationOptions(const Options* options, int rows, int cols, int rank) {
+    if (options->powerIterations > 0 && (rows != cols || options->sparse != 0 || options->vectors > 1 ||
+                                         options->precision != 0 || options->distribution == DISTRIBUTION_PIPELINED)) {
+        if (rank == 0) {
+            fprintf(stderr, "Error: --power-iterations needs a square dense double matrix and cannot be combined with "
+                            "--sparse, --vectors, --precision or --distribution=pipelined.\n");
+        }
+        return -1;
+    }
+    return 0;
+}
+
+// Function to check that --distribution=pipelined is only asked for on the dense double engine, the
+// only one that streams its slabs. Prints an error on root and returns -1 otherwise.
+static inline int checkPipelinedOptions(const Options* options, int rank) {
+    if (options->distribution == DISTRIBUTION_PIPELINED &&
+        (options->sparse != 0 || options->vectors > 1 || options->precision != 0)) {
+        if (rank == 0) {
+            fprintf(stderr, "Error: --distribution=pipelined cannot be combined with --sparse, --vectors or --precision.\n");
+        }
+        return -1;
+    }
+    return 0;
+}
+
+// Function to check that --node-memory=shared is only asked for on the dense double engine with its
+// slabs in place and split evenly: the shared windows are laid out once for the even row split and are
+// filled before the first execution. Prints an error on root and returns -1 otherwise.
+static inline int checkNodeMemoryOptions(const Options* options, int rank) {
+    if (options->sharedMemory && (options->sparse != 0 || options->vectors > 1 || options->precision != 0 ||
+                                  options->distribution == DISTRIBUTION_PIPELINED || options->weighted ||
+                                  options->rebalance > 0)) {
+        if (rank == 0) {
+            fprintf(stderr, "Error: --node-memory=shared cannot be combined with --sparse, --vectors, --precision, "
+                            "--distribution=pipelined, --partition=weighted or --rebalance.\n");
+        }
+        return -1;
+    }
+    return 0;
+}
+
+// Function to check that --partition=weighted and --rebalance are only asked for on the dense double
+// engine, the only one whose plan can split and move its rows. Prints an error on root and returns -1
+// otherwise.
+static inline int checkPartitionOptions(const Options* options, int rank) {
+    if ((options->weighted || options->rebalance > 0) &&
+        (options->sparse != 0 || options->vectors > 1 || options->precision != 0)) {
+        if (rank == 0) {
+            fprintf(stderr, "Error: --partition=weighted and --rebalance cannot be combined with --sparse, --vectors or "
+                            "--precision.\n");
+        }
+        return -1;
+    }
+    return 0;
+}
+
+// Function to open a matrix file for collective reading (--input): the file holds the rows x cols
+// doubles in row-major order without a header, the layout --output=binary writes. Collective buffering
+// is asked for, so the small strided pieces of every rank become large contiguous file accesses.
+// Returns 0 on success; on error root reports it and every rank returns -1.
+static inline int openMatrixFile(const char* path, int rows, int cols, MPI_Comm comm, MPI_File* file) {
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Info info;
+    MPI_Info_create(&info);
+    MPI_Info_set(info, "romio_cb_read", "enable");
+    MPI_Info_set(info, "collective_buffering", "true");
+    int error = MPI_File_open(comm, path, MPI_MODE_RDONLY, info, file);
+    MPI_Info_free(&info);
+    if (error != MPI_SUCCESS) {
+        if (rank == 0) {
+            fprintf(stderr, "Error: could not open the matrix file %s.\n", path);
+        }
+        return -1;
+    }
+    MPI_Offset bytes;
+    MPI_File_get_size(*file, &bytes);
+    if (bytes != (MPI_Offset)rows * cols * (MPI_Offset)sizeof(double)) {
+        if (rank == 0) {
+            fprintf(stderr, "Error: %s holds %lld bytes, a %d x %d matrix of doubles needs %lld.\n", path, (long long)bytes,
+                    rows, cols, (long long)rows * cols * (long long)sizeof(double));
+        }
+        MPI_File_close(file);
+        return -1;
+    }
+    return 0;
+}
+
+// Function to read the block of a matrix file starting at (rowBegin, colBegin) into local (which has
+// the block's shape) with one collective MPI_File_read_at_all per rank; the row padding is cleared.
+// Collective; returns 0 on success, -1 on error (on every rank).
+static inline int readMatrixBlock(const char* path, int rows, int cols, Matrix* local, int rowBegin, int colBegin, MPI_Comm comm) {
+    MPI_File file;
+    if (openMatrixFile(path, rows, cols, comm, &file) != 0) {
+        return -1;
+    }
+    // The file view selects the block, the memory type skips the row padding. A rank with an empty block
+    // (more ranks than rows) cannot describe it as a subarray; it keeps the plain view and reads nothing,
+    // but still joins the collective calls
+    int empty = local->rows == 0 || local->cols == 0;
+    MPI_Datatype fileType = MPI_DOUBLE, memoryType = MPI_DOUBLE;
+    if (!empty) {
+        int sizes[2] = {rows, cols};
+        int subsizes[2] = {local->rows, local->cols};
+        int starts[2] = {rowBegin, colBegin};
+        MPI_Type_create_subarray(2, sizes, subsizes, starts, MPI_ORDER_C, MPI_DOUBLE, &fileType);
+        MPI_Type_vector(local->rows, local->cols, local->ld, MPI_DOUBLE, &memoryType);
+        MPI_Type_commit(&fileType);
+        MPI_Type_commit(&memoryType);
+    }
+    int error = MPI_File_set_view(file, 0, MPI_DOUBLE, fileType, "native", MPI_INFO_NULL);
+    if (error == MPI_SUCCESS) {
+        error = MPI_File_read_at_all(file, 0, local->data, empty ? 0 : 1, memoryType, MPI_STATUS_IGNORE);
+    }
+    MPI_File_close(&file);
+    if (!empty) {
+        MPI_Type_free(&fileType);
+        MPI_Type_free(&memoryType);
+    }
+    for (int i = 0; i < local->rows; i++) {
+        memset(MATRIX_ROW(local, i) + local->cols, 0, (local->ld - local->cols) * sizeof(double));
+    }
+
+    int failed = error != MPI_SUCCESS, anyFailed;
+    MPI_Allreduce(&failed, &anyFailed, 1, MPI_INT, MPI_LOR, comm);
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    if (anyFailed && rank == 0) {
+        fprintf(stderr, "Error: could not read the matrix file %s.\n", path);
+    }
+    return anyFailed ? -1 : 0;
+}
+
+// Function to hand the plan its matrix from a file: every rank reads its own row slab in parallel with
+// MPI-IO, so no rank funnels the data. Collective; returns 0 on success, -1 on error.
+static inline int readMpiMatvecPlan(MpiMatvecPlan* plan, const char* path) {
+    int status = readMatrixBlock(path, plan->rows, plan->cols, &plan->local, plan->rowDispls[plan->rank], 0, plan->comm);
+    if (plan->sharedVector != NULL) {
+        syncSharedWindow(plan->matrixWindow, plan->nodeComm);
+    }
+    return status;
+}
+
+// Function to hand the grid plan its matrix from a file: every rank reads its own block in parallel
+static inline int readMpiGridPlan(MpiGridPlan* plan, const char* path) {
+    return readMatrixBlock(path, plan->rows, plan->cols, &plan->local, plan->rowBegin, plan->colBegin, plan->comm);
+}
+
+// Function to output a result that is left distributed in row slabs of cols values per row, stored
+// with leading dimension ld (counts and displs in rows). The checksum is reduced from per-rank terms
+// and a binary file is written by all ranks at their own offsets with collective MPI-IO, so neither
+// gathers the result; text and binary on standard output gather it on root. Collective; returns 0 on
+// success, -1 on error (on every rank).
+static inline int outputDistributedRows(const Options* options, const double* localResult, int cols, int ld,
+                                        const int* counts, const int* displs, int rows, int root, MPI_Comm comm) {
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    int status = 0;
+    if (options->output == OUTPUT_NONE) {
+        return 0;
+    }
+    if (options->output == OUTPUT_CHECKSUM) {
+        double terms[2], totals[2];
+        uint64_t hash, totalHash;
+        checksumTerms(localResult, counts[rank], cols, ld, displs[rank], &terms[0], &terms[1], &hash);
+        MPI_Reduce(terms, totals, 2, MPI_DOUBLE, MPI_SUM, root, comm);
+        MPI_Reduce(&hash, &totalHash, 1, MPI_UINT64_T, MPI_SUM, root, comm);
+        if (rank == root) {
+            printChecksumLine((long)rows * cols, totals[0], totals[1], totalHash);
+        }
+        return 0;
+    }
+    if (options->output == OUTPUT_BINARY && options->outputFile != NULL) {
+        // The padding of the rows is skipped by a strided memory type, so the file holds them packed
+        MPI_Datatype rowsType;
+        MPI_Type_vector(counts[rank], cols, ld, MPI_DOUBLE, &rowsType);
+        MPI_Type_commit(&rowsType);
+        MPI_File file;
+        int error = MPI_File_open(comm, options->outputFile, MPI_MODE_WRONLY | MPI_MODE_CREATE, MPI_INFO_NULL, &file);
+        if (error == MPI_SUCCESS) {
+            MPI_File_set_size(file, (MPI_Offset)rows * cols * sizeof(double));
+            error = MPI_File_write_at_all(file, (MPI_Offset)displs[rank] * cols * sizeof(double), localResult, 1,
+                                          rowsType, MPI_STATUS_IGNORE);
+            MPI_File_close(&file);
+        }
+        MPI_Type_free(&rowsType);
+        status = error == MPI_SUCCESS ? 0 : -1;
+        MPI_Allreduce(MPI_IN_PLACE, &status, 1, MPI_INT, MPI_MIN, comm);
+        if (status != 0 && rank == root) {
+            fprintf(stderr, "Error: could not write the result to %s.\n", options->outputFile);
+        }
+        return status;
+    }
+
+    // The remaining modes write from one place, so the slabs are gathered on root
+    double* result = NULL;
+    if (rank == root) {
+        result = allocAligned((size_t)rows * ld);
+        if (result == NULL) {
+            fprintf(stderr, "Memory allocation failed for the result.\n");
+            MPI_Abort(comm, EXIT_FAILURE);
+        }
+    }
+    gatherRows(localResult, result, ld * (int)sizeof(double), counts, displs, root, comm);
+    if (rank == root) {
+        status = outputResult(options, result, rows, cols, ld);
+        free(result);
+    }
+    MPI_Bcast(&status, 1, MPI_INT, root, comm);
+    return status;
+}
+
+// Function to output a result that is left distributed in row slabs of one value per row, see
+// outputDistributedRows
+static inline int outputDistributedResult(const Options* options, const double* localResult, const int* counts,
+                                          const int* displs, int rows, int root, MPI_Comm comm) {
+    return outputDistributedRows(options, localResult, 1, 1, counts, displs, rows, root, comm);
+}
+
+#endif // MXV_MPI_H
@@ -4,56 +4,343 @@
  * Desc: MPI Naive version of matrix vector multiplication. 
  */
 
+#define _GNU_SOURCE // sched_setaffinity and sched_getcpu, used by mXv_numa.h through mXv_mpi.h
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
 #include <mpi.h>
+#include "mXv_matrix.h"
+#include "mXv_simd.h"
+#include "mXv_options.h"
+#include "mXv_sparse.h"
+#include "mXv_lowp.h"
+#include "mXv_output.h"
+#include "mXv_mpi.h"
 
-// Function to dynamically allocate a matrix and fill it with random values
-double *createMatrix(int rows, int cols)
+// Function for multiplying the matrix by a block of vectors (one per column of vectors), every one of the
+// rank's threads taking its own row band
+void matrixMultiVectorMultiply(const Matrix *matrix, const Matrix *vectors, Matrix *results, int threads)
 {
-    double *matrix = (double *)malloc(rows * cols * sizeof(double));
-    for (int i = 0; i < rows * cols; i++)
+    GemvBatchKernel kernel = selectGemvBatchKernel();
+#ifdef _OPENMP
+    #pragma omp parallel num_threads(threads) if (threads > 1)
     {
-        matrix[i] = rand() / (double)RAND_MAX;
+        int rowBegin, rowEnd;
+        rowBand(matrix->rows, omp_get_num_threads(), omp_get_thread_num(), &rowBegin, &rowEnd);
+        kernel(matrix, vectors, results, rowBegin, rowEnd);
     }
-    return matrix;
+#else
+    (void)threads;
+    kernel(matrix, vectors, results, 0, matrix->rows);
+#endif
 }
-// Function to dynamically allocate a vector and fill it with random values
-double *createVector(int size)
+
+// Function for matrix-vector multiplication with a reduced precision matrix over the rank's threads
+void matrixVectorMultiplyLowp(const LowpMatrix *matrix, const double *vector, double *result, int threads)
 {
-    double *vector = (double *)malloc(size * sizeof(double));
-    for (int i = 0; i < size; i++)
+    LowpKernel kernel = selectLowpKernel();
+#ifdef _OPENMP
+    #pragma omp parallel num_threads(threads) if (threads > 1)
     {
-        vector[i] = rand() / (double)RAND_MAX;
+        int rowBegin, rowEnd;
+        rowBand(matrix->rows, omp_get_num_threads(), omp_get_thread_num(), &rowBegin, &rowEnd);
+        kernel(matrix, vector, result, rowBegin, rowEnd);
     }
-    return vector;
+#else
+    (void)threads;
+    kernel(matrix, vector, result, 0, matrix->rows);
+#endif
 }
 
-void matrixVectorMultiply(double *matrix, double *vector, double *result, int rows, int cols)
+// Multi-vector mode: every rank generates its rows (or root scatters them) and root broadcasts the whole
+// block of k vectors; every rank multiplies its rows by all of them in one pass and the k results per
+// row are gathered back, or output where they are with --result=distributed
+int runMultiVector(int rank, int size, int matrixRows, int matrixCols, int threads, const Options *options)
 {
-    for (int i = 0; i < rows; i++)
-    {
-        result[i] = 0.0;
-        for (int j = 0; j < cols; j++)
-        {
-            result[i] += matrix[i * cols + j] * vector[j];
+    int k = options->vectors;
+    int rowBegin, rowEnd;
+    rowBand(matrixRows, size, rank, &rowBegin, &rowEnd);
+
+    Matrix localMatrix = allocMatrix(rowEnd - rowBegin, matrixCols);
+    Matrix localResults = allocMatrix(rowEnd - rowBegin, k);
+    Matrix matrix = {NULL, 0, 0, 0};
+    Matrix results = {NULL, 0, 0, 0};
+    Matrix vectors;
+    if (rank == 0) {
+        if (options->distribution != DISTRIBUTION_LOCAL) {
+            matrix = createMatrix(matrixRows, matrixCols, randomKey(options->seed, RANDOM_STREAM_MATRIX));
+        }
+        vectors = createMatrix(matrixCols, k, randomKey(options->seed, RANDOM_STREAM_VECTOR)); // One vector per column
+        if (!options->distributedResult) {
+            results = allocMatrix(matrixRows, k);
+        }
+    } else {
+        vectors = allocMatrix(matrixCols, k);
+    }
+    if (localMatrix.data == NULL || localResults.data == NULL || vectors.data == NULL ||
+        (rank == 0 && ((options->distribution != DISTRIBUTION_LOCAL && matrix.data == NULL) ||
+                       (!options->distributedResult && results.data == NULL)))) {
+        fprintf(stderr, "Memory allocation failed for matrix or vectors.\n");
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+
+    // Per-rank row counts and first rows of the slabs; the matrix and the results travel in whole (padded)
+    // rows, so the counts stay small however large a slab is
+    int *rowCounts = malloc(size * sizeof(int));
+    int *rowDispls = malloc(size * sizeof(int));
+    rowCountsAndDispls(matrixRows, size, rowCounts, rowDispls);
+
+    // Every rank generates its own row slab, or root scatters them
+    if (options->distribution == DISTRIBUTION_LOCAL) {
+        fillMatrixRows(&localMatrix, randomKey(options->seed, RANDOM_STREAM_MATRIX), 0, localMatrix.rows, rowBegin);
+    } else {
+        scatterRows(matrix.data, localMatrix.data, localMatrix.ld * (int)sizeof(double), rowCounts, rowDispls, 0, MPI_COMM_WORLD);
+    }
+    MPI_Bcast(vectors.data, matrixCols * vectors.ld, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+
+    // Perform the local multiplication for all vectors at once
+    matrixMultiVectorMultiply(&localMatrix, &vectors, &localResults, threads);
+
+    // Gather the results on root and output them, or output them where they are
+    int status = 0;
+    if (options->distributedResult) {
+        status = outputDistributedRows(options, localResults.data, k, localResults.ld, rowCounts, rowDispls, matrixRows,
+                                       0, MPI_COMM_WORLD);
+    } else {
+        gatherRows(localResults.data, results.data, localResults.ld * (int)sizeof(double), rowCounts, rowDispls, 0,
+                   MPI_COMM_WORLD);
+        if (rank == 0) {
+            status = outputResult(options, results.data, results.rows, results.cols, results.ld);
+        }
+    }
+    freeMatrix(&matrix);
+    freeMatrix(&results);
+
+    // Cleanup
+    freeMatrix(&localMatrix);
+    freeMatrix(&localResults);
+    freeMatrix(&vectors);
+    free(rowCounts);
+    free(rowDispls);
+    return status == 0 ? 0 : 1;
+}
+
+
+// Sparse mode: every rank generates the CSR slab of its own rows (same row split as the dense path), or
+// with --distribution=scatter root builds the whole CSR matrix and scatters the slabs; every rank
+// converts its slab to SELL-C-sigma if asked and multiplies it
+int runSparse(int rank, int size, int matrixRows, int matrixCols, int threads, const Options *options)
+{
+    int rowBegin, rowEnd;
+    rowBand(matrixRows, size, rank, &rowBegin, &rowEnd);
+    int localRows = rowEnd - rowBegin;
+    int *rowCounts = malloc(size * sizeof(int));
+    int *rowDispls = malloc(size * sizeof(int));
+    rowCountsAndDispls(matrixRows, size, rowCounts, rowDispls);
+
+    double *vector = NULL;
+    if (rank == 0) {
+        vector = createVector(matrixCols, randomKey(options->seed, RANDOM_STREAM_VECTOR));
+    } else {
+        vector = allocAligned(matrixCols);
+    }
+    if (vector == NULL) {
+        fprintf(stderr, "Memory allocation failed for vector.\n");
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+
+    SparseMatrix localSparse;
+    if (options->distribution == DISTRIBUTION_LOCAL) {
+        if (createSparseRows(&localSparse, rowBegin, rowEnd, matrixCols, options->sparse, options->density, options->sigma,
+                             options->seed) != 0) {
+            fprintf(stderr, "Memory allocation failed for sparse slab.\n");
+            MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+        }
+    } else {
+        SparseMatrix sparse;
+        memset(&sparse, 0, sizeof(sparse));
+        if (rank == 0 && createSparse(&sparse, matrixRows, matrixCols, SPARSE_CSR, options->density, options->sigma,
+                                      options->seed) != 0) {
+            fprintf(stderr, "Memory allocation failed for sparse matrix.\n");
+            MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+        }
+
+        // Nonzero counts of every rank's slab
+        int *nnzCounts = malloc(size * sizeof(int));
+        int *nnzDispls = malloc(size * sizeof(int));
+        if (rank == 0) {
+            for (int r = 0; r < size; r++) {
+                int begin = rowDispls[r];
+                int end = begin + rowCounts[r];
+                nnzCounts[r] = (int)(sparse.csr.rowPtr[end] - sparse.csr.rowPtr[begin]);
+                nnzDispls[r] = (int)sparse.csr.rowPtr[begin];
+            }
+        }
+        MPI_Bcast(nnzCounts, size, MPI_INT, 0, MPI_COMM_WORLD);
+
+        CsrMatrix local = allocCsr(localRows, matrixCols, nnzCounts[rank]);
+        if (local.rowPtr == NULL || local.colIdx == NULL || local.values == NULL) {
+            fprintf(stderr, "Memory allocation failed for sparse slab.\n");
+            MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+        }
+
+        // Scatter the row offsets, column indices and values of each slab, then rebase the offsets
+        MPI_Scatterv(rank == 0 ? sparse.csr.rowPtr : NULL, rowCounts, rowDispls, MPI_LONG, local.rowPtr, localRows, MPI_LONG, 0, MPI_COMM_WORLD);
+        MPI_Scatterv(rank == 0 ? sparse.csr.colIdx : NULL, nnzCounts, nnzDispls, MPI_INT, local.colIdx, nnzCounts[rank], MPI_INT, 0, MPI_COMM_WORLD);
+        MPI_Scatterv(rank == 0 ? sparse.csr.values : NULL, nnzCounts, nnzDispls, MPI_DOUBLE, local.values, nnzCounts[rank], MPI_DOUBLE, 0, MPI_COMM_WORLD);
+        long first = localRows > 0 ? local.rowPtr[0] : 0;
+        for (int i = 0; i < localRows; i++) {
+            local.rowPtr[i] -= first;
+        }
+        local.rowPtr[localRows] = nnzCounts[rank];
+
+        if (makeSparse(&localSparse, local, options->sparse, options->sigma) != 0) {
+            fprintf(stderr, "Memory allocation failed for SELL-C-sigma slab.\n");
+            MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+        }
+        freeSparse(&sparse);
+        free(nnzCounts);
+        free(nnzDispls);
+    }
+
+    // Broadcast the vector to all processes
+    MPI_Bcast(vector, matrixCols, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+
+    double *localResults = allocAligned(localRows);
+    if (localResults == NULL) {
+        fprintf(stderr, "Memory allocation failed for the local result.\n");
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+
+    // Perform the local sparse matrix-vector multiplication, with the rank's threads if it has several
+#ifdef _OPENMP
+    if (threads > 1) {
+        sparseMatrixVectorMultiplyOpenMP(&localSparse, vector, localResults);
+    } else {
+        sparseMatrixVectorMultiply(&localSparse, vector, localResults);
+    }
+#else
+    (void)threads;
+    sparseMatrixVectorMultiply(&localSparse, vector, localResults);
+#endif
+
+    // The nonzeros of the whole matrix, only reported with the text output
+    long localNnz = localSparse.csr.nnz;
+    long nnz = 0;
+    MPI_Reduce(&localNnz, &nnz, 1, MPI_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+    if (rank == 0 && options->output == OUTPUT_TEXT) {
+        printf("Sparse matrix with %ld nonzeros\n", nnz);
+    }
+
+    // Gather the local results on root and output them, or output them where they are
+    int status = 0;
+    if (options->distributedResult) {
+        status = outputDistributedResult(options, localResults, rowCounts, rowDispls, matrixRows, 0, MPI_COMM_WORLD);
+    } else {
+        double *result = NULL;
+        if (rank == 0) {
+            result = allocAligned(matrixRows);
+        }
+        MPI_Gatherv(localResults, localRows, MPI_DOUBLE, result, rowCounts, rowDispls, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+        if (rank == 0) {
+            status = outputResult(options, result, matrixRows, 1, 1);
+            free(result);
         }
     }
+
+    // Cleanup
+    freeSparse(&localSparse);
+    free(localResults);
+    free(vector);
+    free(rowCounts);
+    free(rowDispls);
+    return status == 0 ? 0 : 1;
+}
+
+
+// Reduced precision mode: root generates the matrix directly in the narrow format and scatters the
+// row slabs as raw bytes, so 2-8x fewer bytes cross the network than with doubles
+int runLowPrecision(int rank, int size, int matrixRows, int matrixCols, int threads, const Options *options)
+{
+    int rowBegin, rowEnd;
+    rowBand(matrixRows, size, rank, &rowBegin, &rowEnd);
+    int *rowCounts = malloc(size * sizeof(int));
+    int *rowDispls = malloc(size * sizeof(int));
+    rowCountsAndDispls(matrixRows, size, rowCounts, rowDispls);
+
+    LowpMatrix local = allocLowpMatrix(rowEnd - rowBegin, matrixCols, options->precision);
+    // Root process creates the vector, and the full matrix when it is scattered
+    LowpMatrix matrix = {options->precision, 0, 0, 0, NULL, NULL};
+    double *vector = NULL;
+    if (rank == 0) {
+        if (options->distribution != DISTRIBUTION_LOCAL) {
+            matrix = createLowpMatrix(matrixRows, matrixCols, options->precision, randomKey(options->seed, RANDOM_STREAM_MATRIX));
+        }
+        vector = createVector(matrixCols, randomKey(options->seed, RANDOM_STREAM_VECTOR));
+    } else {
+        vector = allocAligned(matrixCols);
+    }
+    double *localResults = allocAligned(rowEnd - rowBegin);
+    if (local.data == NULL || vector == NULL || localResults == NULL || (rank == 0 && options->distribution != DISTRIBUTION_LOCAL && matrix.data == NULL)) {
+        fprintf(stderr, "Memory allocation failed for matrix or vector.\n");
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+
+    // Every rank generates its own reduced precision row slab, or root scatters them; then broadcast the vector
+    if (options->distribution == DISTRIBUTION_LOCAL) {
+        if (fillLowpRows(&local, randomKey(options->seed, RANDOM_STREAM_MATRIX), 0, local.rows, rowBegin) != 0) {
+            fprintf(stderr, "Memory allocation failed for matrix.\n");
+            MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+        }
+    } else {
+        scatterLowpRows(&matrix, &local, rowCounts, rowDispls, 0, MPI_COMM_WORLD);
+    }
+    MPI_Bcast(vector, matrixCols, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+
+    // Perform the local matrix-vector multiplication, widening the elements on the fly
+    matrixVectorMultiplyLowp(&local, vector, localResults, threads);
+
+    // Gather the local results on root and output them, or output them where they are
+    int status = 0;
+    if (options->distributedResult) {
+        status = outputDistributedResult(options, localResults, rowCounts, rowDispls, matrixRows, 0, MPI_COMM_WORLD);
+    } else {
+        double *result = NULL;
+        if (rank == 0) {
+            result = allocAligned(matrixRows);
+        }
+        MPI_Gatherv(localResults, rowEnd - rowBegin, MPI_DOUBLE, result, rowCounts, rowDispls, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+        if (rank == 0) {
+            status = outputResult(options, result, matrixRows, 1, 1);
+            free(result);
+        }
+    }
+
+    // Cleanup
+    freeLowpMatrix(&matrix);
+    freeLowpMatrix(&local);
+    free(localResults);
+    free(vector);
+    free(rowCounts);
+    free(rowDispls);
+    return status == 0 ? 0 : 1;
 }
 
 
 
 int main(int argc, char* argv[]) {
-    MPI_Init(&argc, &argv);
+    // Only the main thread of a rank calls MPI; the OpenMP threads of the hybrid engine just compute
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
     int rank, size;
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
     MPI_Comm_size(MPI_COMM_WORLD, &size);
 
     // Ensure the correct number of arguments are provided
-    if (argc != 3) {
+    Options options;
+    if (argc < 3 || parseOptions(argc, argv, 3, &options) != 0) {
         if (rank == 0) {
-            fprintf(stderr, "Usage: %s <matrixRows> <matrixCols>\n", argv[0]);
+            fprintf(stderr, "Usage: %s <matrixRows> <matrixCols> [--vectors=<k>] [--sparse=csr|sell] [--density=<d>] [--sigma=<rows>] [--precision=f64|f32|bf16|i8] [--seed=<n>] [--repeat=<n>] [--power-iterations=<n>] [--distribution=local|scatter|pipelined] [--chunks=<n>] [--threads=<n>] [--node-memory=private|shared] [--partition=even|weighted] [--rebalance=<n>] [--affinity=none|compact|scatter] [--result=gather|distributed] [--output=none|checksum|binary|text] [--output-file=<path>] [--input=<path>]\n", argv[0]);
         }
         MPI_Finalize();
         return 1;
@@ -68,60 +355,162 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
-    // Calculate the number of rows per process
-    int rowsPerProcess = matrixRows / size;
-    int remainingRows = matrixRows % size;
-    if (rank < remainingRows) {
-        rowsPerProcess++;
+    if (checkEngineOptions(&options) != 0 || checkInputOptions(&options, rank) != 0 ||
+        checkPowerIterationOptions(&options, matrixRows, matrixCols, rank) != 0 ||
+        checkPipelinedOptions(&options, rank) != 0 || checkNodeMemoryOptions(&options, rank) != 0 ||
+        checkPartitionOptions(&options, rank) != 0) {
+        MPI_Finalize();
+        return 1;
     }
 
-    // Allocate memory for local matrix and results
-    double* localMatrix = (double*)malloc(matrixCols * rowsPerProcess * sizeof(double));
-    double* localResults = (double*)calloc(rowsPerProcess, sizeof(double));
-    double* vector = NULL;
+    // Hybrid engine: with --threads=n every rank multiplies its slab with n OpenMP threads, so one rank per
+    // node or socket replaces n single-threaded ranks and their copies of the vector. Set up before any
+    // mode runs, so every mode (and the OpenMP regions that create its data) uses n pinned threads
+    int threads = setupRankThreads(&options, provided, rank);
 
-    // Root process creates the full matrix and vector
-    double* matrix = NULL;
-    if (rank == 0) {
-        matrix = createMatrix(matrixRows, matrixCols);
-        vector = createVector(matrixCols);
-    } else {
-        vector = (double*)malloc(matrixCols * sizeof(double));
+    if (options.precision != PRECISION_F64) {
+        int status = runLowPrecision(rank, size, matrixRows, matrixCols, threads, &options);
+        MPI_Finalize();
+        return status;
     }
 
-    // Scatter the matrix to all processes
-    MPI_Scatter(matrix, matrixCols * rowsPerProcess, MPI_DOUBLE, localMatrix, matrixCols * rowsPerProcess, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    if (options.sparse != SPARSE_NONE) {
+        int status = runSparse(rank, size, matrixRows, matrixCols, threads, &options);
+        MPI_Finalize();
+        return status;
+    }
 
-    // Broadcast the vector to all processes
-    MPI_Bcast(vector, matrixCols, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    if (options.vectors > 1) {
+        int status = runMultiVector(rank, size, matrixRows, matrixCols, threads, &options);
+        MPI_Finalize();
+        return status;
+    }
+
+    // Plan the distributed multiplication once: the row split (uneven sizes are fine), the local slab and
+    // the plan of its multiplication are set up here and reused by every execution. With --node-memory=shared
+    // the slabs and one copy of the vector per node live in shared memory windows instead
+    MpiMatvecPlan plan;
+    MatvecEngine engine = threads > 1 ? ENGINE_OPENMP : ENGINE_SEQUENTIAL;
+    // With --partition=weighted the rows are split in proportion to the calibrated speed of every rank
+    int planStatus;
+    if (options.sharedMemory) {
+        planStatus = createSharedMpiMatvecPlan(&plan, engine, matrixRows, matrixCols, threads, 0, MPI_COMM_WORLD);
+    } else if (options.weighted) {
+        planStatus = createWeightedMpiMatvecPlan(&plan, engine, matrixRows, matrixCols, threads, 0, 0, MPI_COMM_WORLD);
+        printRowPartition(&plan, "Weighted row partition");
+    } else {
+        planStatus = createMpiMatvecPlan(&plan, engine, matrixRows, matrixCols, threads, 0, 0, MPI_COMM_WORLD);
+    }
+    if (planStatus != 0) {
+        fprintf(stderr, "Memory allocation failed for the execution plan.\n");
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
 
-    // Perform the local matrix-vector multiplication
-    matrixVectorMultiply(localMatrix, vector, localResults, rowsPerProcess, matrixCols);
+    // Hand the plan its matrix: by default every rank generates only its own row slab, so no rank ever holds
+    // the whole matrix; with --distribution=scatter root creates it and scatters the slabs once, and with
+    // --distribution=pipelined the slabs are streamed in chunks during the first execution. A matrix file
+    // (--input) is read by all ranks in parallel, each its own slab
+    Matrix matrix = {NULL, 0, 0, 0};
+    if (options.inputFile != NULL) {
+        if (readMpiMatvecPlan(&plan, options.inputFile) != 0) {
+            destroyMpiMatvecPlan(&plan);
+            MPI_Finalize();
+            return 1;
+        }
+    } else if (options.distribution == DISTRIBUTION_LOCAL) {
+        generateMpiMatvecPlan(&plan, randomKey(options.seed, RANDOM_STREAM_MATRIX));
+    } else {
+        if (rank == 0) {
+            matrix = createMatrix(matrixRows, matrixCols, randomKey(options.seed, RANDOM_STREAM_MATRIX));
+            if (matrix.data == NULL) {
+                fprintf(stderr, "Memory allocation failed for matrix.\n");
+                MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+            }
+        }
+        if (options.distribution == DISTRIBUTION_SCATTER) {
+            scatterMpiMatvecPlan(&plan, &matrix);
+            freeMatrix(&matrix);
+        } else if (createMpiMatvecPipeline(&plan, options.chunks) != 0) {
+            fprintf(stderr, "Memory allocation failed for the execution plan.\n");
+            MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+        }
+    }
 
-    // Gather the local results into the final result vector
+    // Root process creates the vector; the result is only allocated on root when it is gathered. The power
+    // iteration keeps its x in vector on every rank, so there is no separate result
+    int iterate = options.powerIterations > 0;
+    int privateVector = !options.sharedMemory || iterate;
+    double* vector = NULL;
     double* result = NULL;
     if (rank == 0) {
-        result = (double*)malloc(matrixRows * sizeof(double));
+        vector = createVector(matrixCols, randomKey(options.seed, RANDOM_STREAM_VECTOR));
+        result = options.distributedResult || iterate ? NULL : allocAligned(matrixRows);
+    } else if (privateVector) {
+        vector = allocAligned(matrixCols);
+    }
+    if ((vector == NULL && (rank == 0 || privateVector)) || (rank == 0 && !options.distributedResult && !iterate && result == NULL)) {
+        fprintf(stderr, "Memory allocation failed for vector.\n");
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
     }
-    MPI_Gather(localResults, rowsPerProcess, MPI_DOUBLE, result, rowsPerProcess, MPI_DOUBLE, 0, MPI_COMM_WORLD);
 
-    // Root process prints the result
-    if (rank == 0) {
-        printf("Resulting vector:\n");
-        for (int i = 0; i < matrixRows; i++) {
-            printf("%f\n", result[i]);
+    // Power iteration: x <- A x / ||A x|| with the matrix resident, the output is the last x
+    if (iterate) {
+        double start = MPI_Wtime();
+        double eigenvalue = powerIterationMpiMatvecPlan(&plan, vector, options.powerIterations);
+        if (rank == 0) {
+            printPowerIteration(options.powerIterations, MPI_Wtime() - start, eigenvalue);
         }
-        free(result);
+        // On root the last x becomes the result that is output (and freed) below
+        result = rank == 0 ? vector : NULL;
+        vector = rank == 0 ? NULL : vector;
     }
 
-    // Cleanup
-    free(localMatrix);
-    free(localResults);
-    free(vector);
-    if (rank == 0) {
-        free(matrix);
+    // Every execution broadcasts the vector and multiplies the local slab; the result is gathered on root
+    // unless it stays distributed (the row split may change between executions, so the output below uses
+    // the plan's current one). Pipelined executions overlap the transfers with the multiplication of
+    // the chunks, the first one also streaming the slabs themselves
+    double start = MPI_Wtime();
+    for (int r = 0; r < options.repeat && !iterate; r++) {
+        if (options.distribution == DISTRIBUTION_PIPELINED) {
+            pipelineMpiMatvecPlan(&plan, r == 0 ? &matrix : NULL, vector, result, !options.distributedResult);
+            if (r == 0) {
+                freeMatrix(&matrix);
+            }
+        } else if (options.distributedResult) {
+            computeMpiMatvecPlan(&plan, vector);
+        } else {
+            executeMpiMatvecPlan(&plan, vector, result);
+        }
+        // Every --rebalance executions the rows follow the speed each rank showed since the last time
+        if (options.rebalance > 0 && (r + 1) % options.rebalance == 0 && r + 1 < options.repeat) {
+            int moved = rebalanceMpiMatvecPlan(&plan);
+            if (moved < 0) {
+                fprintf(stderr, "Memory allocation failed for the execution plan.\n");
+                MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+            }
+            if (moved) {
+                printRowPartition(&plan, "Rebalanced row partition");
+            }
+        }
     }
+    if (rank == 0 && !iterate) {
+        printRepeatTiming(options.repeat, MPI_Wtime() - start, matrixRows, matrixCols);
+    }
+
+    // Output the result
+    int status = 0;
+    if (options.distributedResult) {
+        status = outputDistributedResult(&options, plan.localResult, plan.rowCounts, plan.rowDispls, matrixRows, 0,
+                                         MPI_COMM_WORLD);
+    } else if (rank == 0) {
+        status = outputResult(&options, result, matrixRows, 1, 1);
+    }
+
+    // Cleanup; on root result is also the last x of a power iteration, whatever the output mode
+    free(result);
+    destroyMpiMatvecPlan(&plan);
+    free(vector);
 
     MPI_Finalize();
-    return 0;
+    return status == 0 ? 0 : 1;
 }
@@ -0,0 +1,226 @@
+/*
+ * Programmer(s) : Syed Saad Ullah Hussaini, K214703 Ali Raza, K213100 Muhammad Sameed
+ * Date: 17 October 2026
+ * Desc: NUMA placement for the OpenMP matrix vector multiplication programs.
+ *       Linux places a page on the node of the thread that first writes it, so
+ *       the matrix is first touched by the same static row bands (rowBand over
+ *       the team) that later multiply it; createMatrix fills it that way.
+ *       Threads can be pinned compactly (fill one node before the next) or
+ *       scattered (round robin over the nodes), and the node holding each band
+ *       can be reported. The topology is read
+ *       from /sys and the page nodes from move_pages(2), so no libnuma is needed.
+ */
+
+#ifndef MXV_NUMA_H
+#define MXV_NUMA_H
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include "mXv_matrix.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Largest number of NUMA nodes looked at in /sys
+#define NUMA_MAX_NODES 64
+
+// Pages sampled per band by the placement report
+#define NUMA_REPORT_SAMPLES 256
+
+typedef enum { AFFINITY_NONE = 0, AFFINITY_COMPACT = 1, AFFINITY_SCATTER = 2 } Affinity;
+
+// Function to read the CPUs of a NUMA node from /sys; returns 0 on success, -1 if the node does not exist
+static inline int numaNodeCpus(int node, cpu_set_t* cpus) {
+    char path[96];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        return -1;
+    }
+    // The list looks like "0-7,16-23"
+    CPU_ZERO(cpus);
+    int first, last;
+    char separator;
+    while (fscanf(file, "%d", &first) == 1) {
+        last = first;
+        if (fscanf(file, "%c", &separator) == 1 && separator == '-') {
+            if (fscanf(file, "%d", &last) != 1) {
+                break;
+            }
+            if (fscanf(file, "%c", &separator) != 1) {
+                separator = '\n';
+            }
+        }
+        for (int cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++) {
+            CPU_SET(cpu, cpus);
+        }
+        if (separator != ',') {
+            break;
+        }
+    }
+    fclose(file);
+    return 0;
+}
+
+// Function to list the CPUs this process may run on in pinning order; returns how many were written.
+// Compact walks node by node, scatter takes one CPU from each node in turn.
+static inline int affinityCpuOrder(Affinity affinity, int* order, int capacity) {
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        return 0;
+    }
+
+    // CPUs of every node, restricted to the allowed set; a machine without /sys/.../node is one node
+    static cpu_set_t nodeCpus[NUMA_MAX_NODES];
+    int nodes = 0;
+    while (nodes < NUMA_MAX_NODES && numaNodeCpus(nodes, &nodeCpus[nodes]) == 0) {
+        CPU_AND(&nodeCpus[nodes], &nodeCpus[nodes], &allowed);
+        nodes++;
+    }
+    if (nodes == 0) {
+        nodeCpus[0] = allowed;
+        nodes = 1;
+    }
+
+    int count = 0;
+    if (affinity == AFFINITY_SCATTER) {
+        int next[NUMA_MAX_NODES] = {0};
+        for (int added = 1; added && count < capacity;) {
+            added = 0;
+            for (int node = 0; node < nodes && count < capacity; node++) {
+                while (next[node] < CPU_SETSIZE && !CPU_ISSET(next[node], &nodeCpus[node])) {
+                    next[node]++;
+                }
+                if (next[node] < CPU_SETSIZE) {
+                    order[count++] = next[node]++;
+                    added = 1;
+                }
+            }
+        }
+    } else {
+        for (int node = 0; node < nodes; node++) {
+            for (int cpu = 0; cpu < CPU_SETSIZE && count < capacity; cpu++) {
+                if (CPU_ISSET(cpu, &nodeCpus[node])) {
+                    order[count++] = cpu;
+                }
+            }
+        }
+    }
+    return count;
+}
+
+// Function to find the NUMA node holding the page at addr; -1 if it is not mapped or the kernel cannot tell
+static inline int numaPageNode(const void* addr) {
+#ifdef SYS_move_pages
+    void* page = (void*)((size_t)addr & ~((size_t)sysconf(_SC_PAGESIZE) - 1));
+    int status = -1;
+    // With no target nodes move_pages only reports where each page currently is
+    if (syscall(SYS_move_pages, 0, 1UL, &page, NULL, &status, 0) == 0 && status >= 0) {
+        return status;
+    }
+#else
+    (void)addr;
+#endif
+    return -1;
+}
+
+#ifdef _OPENMP
+// Function to pin every thread of the OpenMP team to its own CPU. libgomp keeps the same threads
+// for later parallel regions of the same size, so this is done once before the data is touched.
+static inline void pinThreads(Affinity affinity) {
+    if (affinity == AFFINITY_NONE) {
+        return;
+    }
+    static int order[CPU_SETSIZE];
+    int cpus = affinityCpuOrder(affinity, order, CPU_SETSIZE);
+    if (cpus == 0) {
+        fprintf(stderr, "Warning: could not read the CPU affinity, threads are not pinned.\n");
+        return;
+    }
+    #pragma omp parallel
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(order[omp_get_thread_num() % cpus], &set);
+        sched_setaffinity(0, sizeof(set), &set);
+    }
+}
+
+// Function to allocate a vector of count doubles first touched in the same row bands as the matrix
+static inline double* allocVectorFirstTouch(int count) {
+    double* vector = allocAligned(count);
+    if (vector == NULL) {
+        return NULL;
+    }
+    #pragma omp parallel
+    {
+        int begin, end;
+        rowBand(count, omp_get_num_threads(), omp_get_thread_num(), &begin, &end);
+        memset(vector + begin, 0, (size_t)(end - begin) * sizeof(double));
+    }
+    return vector;
+}
+
+// Function to report on standard error, for the row band of every thread, the CPU it runs on and the NUMA
+// node of its pages
+static inline void reportBandNodes(const Matrix* matrix) {
+    int threads = omp_get_max_threads();
+    int* cpu = malloc(threads * sizeof(int));
+    if (cpu == NULL) {
+        return;
+    }
+    // The team granted may be smaller than asked for, so only its bands are reported
+    int team = 1;
+    #pragma omp parallel
+    {
+        cpu[omp_get_thread_num()] = sched_getcpu();
+        #pragma omp single
+        team = omp_get_num_threads();
+    }
+
+    size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    fprintf(stderr, "NUMA placement of the row bands:\n");
+    for (int t = 0; t < team; t++) {
+        int rowBegin, rowEnd;
+        rowBand(matrix->rows, team, t, &rowBegin, &rowEnd);
+        if (rowEnd == rowBegin) {
+            continue;
+        }
+        // Sample pages evenly over the band and count them per node
+        const char* first = (const char*)MATRIX_ROW(matrix, rowBegin);
+        size_t bytes = (size_t)(rowEnd - rowBegin) * matrix->ld * sizeof(double);
+        size_t pages = (bytes + pageSize - 1) / pageSize;
+        size_t samples = pages < NUMA_REPORT_SAMPLES ? pages : NUMA_REPORT_SAMPLES;
+        int counts[NUMA_MAX_NODES + 1] = {0}; // The last slot counts unknown pages
+        for (size_t s = 0; s < samples; s++) {
+            int node = numaPageNode(first + s * pages / samples * pageSize);
+            counts[node >= 0 && node < NUMA_MAX_NODES ? node : NUMA_MAX_NODES]++;
+        }
+        int best = NUMA_MAX_NODES;
+        for (int node = 0; node < NUMA_MAX_NODES; node++) {
+            if (counts[node] > counts[best]) {
+                best = node;
+            }
+        }
+        if (best == NUMA_MAX_NODES) {
+            fprintf(stderr, "Band %d (rows %d-%d, cpu %d): node unknown\n", t, rowBegin, rowEnd - 1, cpu[t]);
+        } else {
+            fprintf(stderr, "Band %d (rows %d-%d, cpu %d): node %d (%.0f%% of sampled pages)\n", t, rowBegin, rowEnd - 1,
+                    cpu[t], best, 100.0 * counts[best] / samples);
+        }
+    }
+    fprintf(stderr, "\n");
+    free(cpu);
+}
+#endif // _OPENMP
+
+#endif // MXV_NUMA_H
@@ -4,118 +4,146 @@
  * Desc: OMP Tiled version of matrix vector multiplication. 
  */
 
+#define _GNU_SOURCE // sched_setaffinity and sched_getcpu, used by mXv_numa.h
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
 #include <omp.h>
-#include <assert.h>
-
-// Function to dynamically allocate a matrix and fill it with random values
-double** createMatrix(int rows, int cols) {
-    double** matrix = (double**)malloc(rows * sizeof(double*));
-    for (int i = 0; i < rows; i++) {
-        matrix[i] = (double*)malloc(cols * sizeof(double));
-        for (int j = 0; j < cols; j++) {
-            matrix[i][j] = rand() / (double)RAND_MAX;
-        }
+#include "mXv_matrix.h"
+#include "mXv_simd.h"
+#include "mXv_options.h"
+#include "mXv_lowp.h"
+#include "mXv_output.h"
+#include "mXv_plan.h"
+#include "mXv_numa.h"
+
+// Function for Tiled OpenMP matrix-vector multiplication with a reduced precision matrix. The per-tile
+// and accumulated partial sums of every band live in one buffer allocated before the parallel region;
+// returns -1 if it could not be allocated
+int matrixVectorMultiplyLowpTiledOpenMP(const LowpMatrix* matrix, const double* vector, double* result, int tileSize) {
+    LowpKernel kernel = selectLowpKernel();
+    int tileCols = chooseTileColumns(matrix->cols, tileSize);
+    double* partial = allocAligned(2 * (size_t)matrix->rows);
+    if (partial == NULL) {
+        return -1;
     }
-    return matrix;
-}
-
-// Function to dynamically allocate a vector and fill it with random values
-double* createVector(int size) {
-    double* vector = (double*)malloc(size * sizeof(double));
-    for (int i = 0; i < size; i++) {
-        vector[i] = rand() / (double)RAND_MAX;
+    #pragma omp parallel
+    {
+        int rowBegin, rowEnd;
+        rowBand(matrix->rows, omp_get_num_threads(), omp_get_thread_num(), &rowBegin, &rowEnd);
+
+        // The thread's own part of the buffer: the partial and the accumulated sums of its band
+        double* band = partial + 2 * (size_t)rowBegin;
+        lowpTiledBand(kernel, matrix, vector, result, rowBegin, rowEnd, tileCols, band, band + (rowEnd - rowBegin));
     }
-    return vector;
+    free(partial);
+    return 0;
 }
 
-// Function for matrix-vector multiplication using Tiled OpenMP
-void matrixVectorMultiplyTiledOpenMP(double** matrix, double* vector, double* result, int rows, int cols, int tileSize) {
-    #pragma omp parallel for collapse(2) schedule(dynamic)
-    for (int i = 0; i < rows; i += tileSize) {
-        for (int j = 0; j < cols; j += tileSize) {
-            // Determine the actual size of the tile (may be smaller at the edges)
-            int tileRowEnd = (i + tileSize > rows) ? rows : i + tileSize;
-            int tileColEnd = (j + tileSize > cols) ? cols : j + tileSize;
-
-            // Perform the multiplication for the current tile
-            for (int k = i; k < tileRowEnd; k++) {
-                for (int l = j; l < tileColEnd; l++) {
-                    #pragma omp atomic
-                    result[k] += matrix[k][l] * vector[l];
-                }
-            }
-        }
-    }
-}
 
 int main(int argc, char* argv[]) {
-    if (argc != 4) {
-        printf("Usage: %s <matrix_rows> <matrix_cols/vector_size> <tile_size>\n", argv[0]);
+    Options options;
+    if (argc < 4 || parseOptions(argc, argv, 4, &options) != 0 || checkEngineOptions(&options) != 0 ||
+        options.sparse != 0 || options.vectors > 1) {
+        printf("Usage: %s <matrix_rows> <matrix_cols/vector_size> <tile_size> [--precision=f64|f32|bf16|i8] [--seed=<n>] [--repeat=<n>] [--output=none|checksum|binary|text] [--output-file=<path>] [--affinity=none|compact|scatter] [--numa-report=off|on]\n", argv[0]);
         return 1;
     }
 
     int matrixRows = atoi(argv[1]);
     int matrixCols = atoi(argv[2]);
-    int tileSize = atoi(argv[3]);
-    assert(matrixRows % tileSize == 0 && matrixCols % tileSize == 0); // Matrix dimensions must be divisible by tile size
+    int tileSize = atoi(argv[3]); // Column tile width; 0 picks one from the L2 cache size
 
     // The number of columns in the matrix must equal the size of the vector
     if (matrixRows <= 0 || matrixCols <= 0) {
         printf("Error: Matrix rows and columns must be greater than 0.\n");
         return 1;
     }
+    if (tileSize < 0) {
+        printf("Error: Tile size must not be negative.\n");
+        return 1;
+    }
+
+    // Keys of the counter-based random streams; the same --seed gives the same data in every program
+    uint64_t matrixKey = randomKey(options.seed, RANDOM_STREAM_MATRIX);
+    uint64_t vectorKey = randomKey(options.seed, RANDOM_STREAM_VECTOR);
+
+    // Pin the threads before anything is touched, so first-touch places each band on its thread's node
+    pinThreads(options.affinity);
+
+    if (options.precision != PRECISION_F64) {
+        // Reduced precision mode: the matrix is stored in fewer bytes per element and widened on the fly
+        LowpMatrix lowp = createLowpMatrix(matrixRows, matrixCols, options.precision, matrixKey);
+        double* vector = createVector(matrixCols, vectorKey);
+        double* result = allocAligned(matrixRows);
+        if (lowp.data == NULL || vector == NULL || result == NULL) {
+            fprintf(stderr, "Memory allocation failed for matrix or vectors.\n");
+            return 1;
+        }
 
-    // Seed the random number generator
-    srand(time(NULL));
+        // Perform the matrix-vector multiplication through Tiled OpenMP
+        if (matrixVectorMultiplyLowpTiledOpenMP(&lowp, vector, result, tileSize) != 0) {
+            fprintf(stderr, "Memory allocation failed for tile buffers.\n");
+            freeLowpMatrix(&lowp);
+            free(vector);
+            free(result);
+            return 1;
+        }
 
-    // Create and fill the matrix and vector with random values
-    double** matrix = createMatrix(matrixRows, matrixCols);
-    double* vector = createVector(matrixCols); // The vector size is the same as the number of columns in the matrix
-    double* result = (double*)malloc(matrixRows * sizeof(double)); // The result vector size is the same as the number of rows in the matrix
+        int status = outputResult(&options, result, matrixRows, 1, 1);
 
-    // Initialize result vector to zero
-    for (int i = 0; i < matrixRows; i++) {
-        result[i] = 0.0;
+        freeLowpMatrix(&lowp);
+        free(vector);
+        free(result);
+        return status == 0 ? 0 : 1;
     }
 
-    // Perform the matrix-vector multiplication through Naive OpemMP
-    matrixVectorMultiplyTiledOpenMP(matrix, vector, result, matrixRows, matrixCols, tileSize);
+    // Create and fill the matrix and vector with random values; every band of the matrix is first touched
+    // by the thread that multiplies it, so its pages live on that thread's NUMA node
+    Matrix matrix = createMatrix(matrixRows, matrixCols, matrixKey);
+    double* vector = createVector(matrixCols, vectorKey); // The vector size is the same as the number of columns in the matrix
+    double* result = allocVectorFirstTouch(matrixRows); // The result vector size is the same as the number of rows in the matrix
+    if (matrix.data == NULL || vector == NULL || result == NULL) {
+        fprintf(stderr, "Memory allocation failed for matrix or vectors.\n");
+        return 1;
+    }
 
-    // Print the generated matrix
-    printf("Generated matrix:\n");
-    for (int i = 0; i < matrixRows; i++) {
-        for (int j = 0; j < matrixCols; j++) {
-            printf("%f ", matrix[i][j]);
-        }
-        printf("\n");
+    // Plan the multiplication once, then execute it --repeat times on the same matrix. Each thread walks its
+    // own band of rows tile by tile, so partial sums stay in buffers of the plan and every element of the
+    // result is written exactly once, without atomics.
+    MatvecPlan plan;
+    if (createMatvecPlan(&plan, ENGINE_TILED, matrixRows, matrixCols, 0, tileSize) != 0) {
+        fprintf(stderr, "Memory allocation failed for the execution plan.\n");
+        return 1;
+    }
+    double start = omp_get_wtime();
+    for (int r = 0; r < options.repeat; r++) {
+        executeMatvecPlan(&plan, &matrix, vector, result);
     }
+    printRepeatTiming(options.repeat, omp_get_wtime() - start, matrixRows, matrixCols);
+    destroyMatvecPlan(&plan);
 
-    printf("\n");
+    if (options.numaReport) {
+        reportBandNodes(&matrix);
+    }
 
-    // Print the generated vector
-    printf("Generated vector:\n");
-    for (int i = 0; i < matrixCols; i++) {
-        printf("%f ", vector[i]);
+    // Print the generated matrix and vector when the text output is asked for
+    if (options.output == OUTPUT_TEXT) {
+        printMatrix("Generated matrix", &matrix);
+        printf("Generated vector:\n");
+        for (int i = 0; i < matrixCols; i++) {
+            printf("%f ", vector[i]);
+        }
+        printf("\n\n");
     }
-    printf("\n\n");
 
     // Print the resultant vector
-    printf("Resulting vector:\n");
-    for (int i = 0; i < matrixRows; i++) {
-        printf("%f\n", result[i]);
-    }
+    int status = outputResult(&options, result, matrixRows, 1, 1);
 
     // Cleanup
-    for (int i = 0; i < matrixRows; i++) {
-        free(matrix[i]);
-    }
-    free(matrix);
+    freeMatrix(&matrix);
     free(vector);
     free(result);
 
-    return 0;
+    return status == 0 ? 0 : 1;
 }
 
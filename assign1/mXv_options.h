@@ -0,0 +1,246 @@
+/*
+ * Programmer(s) : Syed Saad Ullah Hussaini, K214703 Ali Raza, K213100 Muhammad Sameed
+ * Date: 17 October 2026
+ * Desc: Optional --name=value command line arguments shared by the mXv programs.
+ *       They follow the positional size arguments, e.g.
+ *           ./mXv_task02 4096 4096 --vectors=8
+ */
+
+#ifndef MXV_OPTIONS_H
+#define MXV_OPTIONS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include "mXv_random.h"
+
+typedef struct {
+    int vectors;    // Number of right-hand side vectors multiplied in one pass (--vectors=k)
+    int sparse;     // Sparse storage: 0 = dense, 1 = CSR, 2 = SELL-C-sigma (--sparse=csr|sell)
+    double density; // Fraction of nonzeros of the random sparse matrix; 0 converts a dense matrix (--density=d)
+    int sigma;      // Sorting window of SELL-C-sigma in rows (--sigma=rows)
+    int precision;  // Matrix storage: 0 = f64, 1 = f32, 2 = bf16, 3 = int8 with row scales (--precision=...)
+    int affinity;   // Thread pinning: 0 = none, 1 = compact, 2 = scatter (--affinity=none|compact|scatter)
+    int numaReport; // Print the NUMA node of every row band (--numa-report=off|on)
+    uint64_t seed;  // Seed of the counter-based random data; equal seeds give equal data everywhere (--seed=n)
+    int output;     // Result output: 0 = none, 1 = checksum, 2 = raw binary, 3 = text (--output=...)
+    const char* outputFile; // File the binary output goes to, NULL for standard output (--output-file=path)
+    const char* inputFile;  // MPI: raw row-major matrix read with MPI-IO instead of random data, NULL for none (--input=path)
+    int repeat;     // Executions of the planned multiplication on the same matrix (--repeat=n)
+    int powerIterations;   // MPI: steps of the power iteration x <- A x / ||A x||, 0 for a single product (--power-iterations=n)
+    int distribution;      // MPI: 0 = every rank generates its own row slab, 1 = root generates and scatters, 2 = scatters in pipelined chunks (--distribution=...)
+    int chunks;            // MPI: chunks per slab of the pipelined distribution (--chunks=n)
+    int threads;           // MPI: OpenMP threads per rank of the hybrid engine (--threads=n)
+    int weighted;          // MPI: 0 = even row split, 1 = in proportion to each rank's calibrated speed (--partition=even|weighted)
+    int rebalance;         // MPI: executions between rebalances of the rows from measured times, 0 = never (--rebalance=n)
+    int sharedMemory;      // MPI: 0 = private slabs and vector per rank, 1 = one shared copy per node (--node-memory=private|shared)
+    int distributedResult; // MPI: 0 = gather the result on root, 1 = leave it distributed (--result=gather|distributed)
+} Options;
+
+// Function to fill in the default value of every option
+static inline void defaultOptions(Options* options) {
+    options->vectors = 1;
+    options->sparse = 0;
+    options->density = 0.0;
+    options->sigma = 256;
+    options->precision = 0;
+    options->affinity = 0;
+    options->numaReport = 0;
+    options->seed = RANDOM_DEFAULT_SEED;
+    options->output = 1;
+    options->outputFile = NULL;
+    options->inputFile = NULL;
+    options->repeat = 1;
+    options->powerIterations = 0;
+    options->distribution = 0;
+    options->chunks = 8;
+    options->threads = 1;
+    options->sharedMemory = 0;
+    options->weighted = 0;
+    options->rebalance = 0;
+    options->distributedResult = 0;
+}
+
+// Function to parse a strictly positive integer option value
+static inline int parsePositiveInt(const char* name, const char* value, int* out) {
+    char* end = NULL;
+    errno = 0;
+    long parsed = strtol(value, &end, 10);
+    if (errno != 0 || end == value || *end != '\0' || parsed <= 0 || parsed > 1000000000L) {
+        fprintf(stderr, "Error: --%s expects a positive integer, got '%s'.\n", name, value);
+        return -1;
+    }
+    *out = (int)parsed;
+    return 0;
+}
+
+// Function to parse an unsigned 64-bit option value
+static inline int parseSeed(const char* name, const char* value, uint64_t* out) {
+    char* end = NULL;
+    errno = 0;
+    unsigned long long parsed = strtoull(value, &end, 0);
+    if (errno != 0 || end == value || *end != '\0' || value[0] == '-') {
+        fprintf(stderr, "Error: --%s expects an unsigned integer, got '%s'.\n", name, value);
+        return -1;
+    }
+    *out = (uint64_t)parsed;
+    return 0;
+}
+
+// Function to parse a fraction in (0, 1]
+static inline int parseFraction(const char* name, const char* value, double* out) {
+    char* end = NULL;
+    errno = 0;
+    double parsed = strtod(value, &end);
+    if (errno != 0 || end == value || *end != '\0' || !(parsed > 0.0 && parsed <= 1.0)) {
+        fprintf(stderr, "Error: --%s expects a number in (0, 1], got '%s'.\n", name, value);
+        return -1;
+    }
+    *out = parsed;
+    return 0;
+}
+
+// Function to look value up in a list of names; returns its index or -1 (after printing an error)
+static inline int parseChoice(const char* name, const char* value, const char* const* choices, int count) {
+    for (int i = 0; i < count; i++) {
+        if (strcmp(value, choices[i]) == 0) {
+            return i;
+        }
+    }
+    fprintf(stderr, "Error: --%s does not accept '%s'.\n", name, value);
+    return -1;
+}
+
+// Function to check whether the option "--name=value" starting at arg (with '=' at eq) is called name
+static inline int optionIs(const char* arg, const char* eq, const char* name) {
+    size_t nameLen = eq - (arg + 2);
+    return nameLen == strlen(name) && strncmp(arg + 2, name, nameLen) == 0;
+}
+
+// Function to parse argv[first..argc) as --name=value options; returns 0 on success, -1 on error
+static inline int parseOptions(int argc, char* argv[], int first, Options* options) {
+    defaultOptions(options);
+    for (int i = first; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* eq = strchr(arg, '=');
+        if (strncmp(arg, "--", 2) != 0 || eq == NULL) {
+            fprintf(stderr, "Error: unexpected argument '%s' (options look like --name=value).\n", arg);
+            return -1;
+        }
+        const char* value = eq + 1;
+        if (optionIs(arg, eq, "vectors")) {
+            if (parsePositiveInt("vectors", value, &options->vectors) != 0) {
+                return -1;
+            }
+        } else if (optionIs(arg, eq, "sparse")) {
+            static const char* const formats[] = {"dense", "csr", "sell"};
+            options->sparse = parseChoice("sparse", value, formats, 3);
+            if (options->sparse < 0) {
+                return -1;
+            }
+        } else if (optionIs(arg, eq, "density")) {
+            if (parseFraction("density", value, &options->density) != 0) {
+                return -1;
+            }
+        } else if (optionIs(arg, eq, "precision")) {
+            static const char* const precisions[] = {"f64", "f32", "bf16", "i8"};
+            options->precision = parseChoice("precision", value, precisions, 4);
+            if (options->precision < 0) {
+                return -1;
+            }
+        } else if (optionIs(arg, eq, "affinity")) {
+            static const char* const affinities[] = {"none", "compact", "scatter"};
+            options->affinity = parseChoice("affinity", value, affinities, 3);
+            if (options->affinity < 0) {
+                return -1;
+            }
+        } else if (optionIs(arg, eq, "numa-report")) {
+            static const char* const switches[] = {"off", "on"};
+            options->numaReport = parseChoice("numa-report", value, switches, 2);
+            if (options->numaReport < 0) {
+                return -1;
+            }
+        } else if (optionIs(arg, eq, "seed")) {
+            if (parseSeed("seed", value, &options->seed) != 0) {
+                return -1;
+            }
+        } else if (optionIs(arg, eq, "output")) {
+            static const char* const modes[] = {"none", "checksum", "binary", "text"};
+            options->output = parseChoice("output", value, modes, 4);
+            if (options->output < 0) {
+                return -1;
+            }
+        } else if (optionIs(arg, eq, "output-file")) {
+            options->outputFile = value;
+        } else if (optionIs(arg, eq, "input")) {
+            options->inputFile = value;
+        } else if (optionIs(arg, eq, "repeat")) {
+            if (parsePositiveInt("repeat", value, &options->repeat) != 0) {
+                return -1;
+            }
+        } else if (optionIs(arg, eq, "power-iterations")) {
+            if (parsePositiveInt("power-iterations", value, &options->powerIterations) != 0) {
+                return -1;
+            }
+        } else if (optionIs(arg, eq, "distribution")) {
+            static const char* const distributions[] = {"local", "scatter", "pipelined"};
+            options->distribution = parseChoice("distribution", value, distributions, 3);
+            if (options->distribution < 0) {
+                return -1;
+            }
+        } else if (optionIs(arg, eq, "partition")) {
+            static const char* const partitions[] = {"even", "weighted"};
+            options->weighted = parseChoice("partition", value, partitions, 2);
+            if (options->weighted < 0) {
+                return -1;
+            }
+        } else if (optionIs(arg, eq, "rebalance")) {
+            if (parsePositiveInt("rebalance", value, &options->rebalance) != 0) {
+                return -1;
+            }
+        } else if (optionIs(arg, eq, "node-memory")) {
+            static const char* const memories[] = {"private", "shared"};
+            options->sharedMemory = parseChoice("node-memory", value, memories, 2);
+            if (options->sharedMemory < 0) {
+                return -1;
+            }
+        } else if (optionIs(arg, eq, "threads")) {
+            if (parsePositiveInt("threads", value, &options->threads) != 0) {
+                return -1;
+            }
+        } else if (optionIs(arg, eq, "chunks")) {
+            if (parsePositiveInt("chunks", value, &options->chunks) != 0) {
+                return -1;
+            }
+        } else if (optionIs(arg, eq, "result")) {
+            static const char* const results[] = {"gather", "distributed"};
+            options->distributedResult = parseChoice("result", value, results, 2);
+            if (options->distributedResult < 0) {
+                return -1;
+            }
+        } else if (optionIs(arg, eq, "sigma")) {
+            if (parsePositiveInt("sigma", value, &options->sigma) != 0) {
+                return -1;
+            }
+        } else {
+            fprintf(stderr, "Error: unknown option '%.*s'.\n", (int)(eq - arg), arg);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Function to check that at most one of the alternative engines (sparse, multi-vector, reduced
+// precision) was asked for; prints an error and returns -1 otherwise
+static inline int checkEngineOptions(const Options* options) {
+    int engines = (options->sparse != 0) + (options->vectors > 1) + (options->precision != 0);
+    if (engines > 1) {
+        fprintf(stderr, "Error: --sparse, --vectors and --precision cannot be combined.\n");
+        return -1;
+    }
+    return 0;
+}
+
+#endif // MXV_OPTIONS_H
@@ -0,0 +1,158 @@
+/*
+ * Programmer(s) : Syed Saad Ullah Hussaini, K214703 Ali Raza, K213100 Muhammad Sameed
+ * Date: 17 October 2026
+ * Desc: Result output of the mXv programs (--output=none|checksum|binary|text).
+ *       checksum prints the sum, the 2-norm and an order independent hash of the
+ *       bits of the result, binary writes the raw doubles (row-major, no row
+ *       padding) with a single write, and text is the old human readable dump,
+ *       kept for debugging small sizes.
+ */
+
+#ifndef MXV_OUTPUT_H
+#define MXV_OUTPUT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "mXv_matrix.h"
+#include "mXv_random.h"
+#include "mXv_options.h"
+
+typedef enum { OUTPUT_NONE = 0, OUTPUT_CHECKSUM = 1, OUTPUT_BINARY = 2, OUTPUT_TEXT = 3 } OutputMode;
+
+// Function to accumulate the checksum terms of a rows x cols result stored with leading dimension ld
+// whose first row is row firstRow of the whole result. Each element's bits are hashed with its global
+// index and the hashes are added, so the reduction order (thread or rank count) does not change the
+// hash; bit-identical results give identical hashes.
+static inline void checksumTerms(const double* data, int rows, int cols, int ld, long firstRow, double* sum,
+                                 double* squares, uint64_t* hash) {
+    double s = 0.0;
+    double q = 0.0;
+    uint64_t h = 0;
+#ifdef _OPENMP
+    #pragma omp parallel for reduction(+:s, q, h) schedule(static)
+#endif
+    for (int i = 0; i < rows; i++) {
+        const double* row = data + (size_t)i * ld;
+        for (int j = 0; j < cols; j++) {
+            uint64_t bits;
+            memcpy(&bits, &row[j], sizeof(bits));
+            s += row[j];
+            q += row[j] * row[j];
+            h += splitMix64(bits ^ splitMix64((uint64_t)(firstRow + i) * cols + j));
+        }
+    }
+    *sum = s;
+    *squares = q;
+    *hash = h;
+}
+
+// Function to print the checksum line from its accumulated terms
+static inline void printChecksumLine(long elements, double sum, double squares, uint64_t hash) {
+    printf("Result checksum: elements=%ld sum=%.17g norm=%.17g hash=%016llx\n", elements, sum, sqrt(squares),
+           (unsigned long long)hash);
+}
+
+// Function to print the checksum line of a rows x cols result stored with leading dimension ld
+static inline void printChecksum(const double* data, int rows, int cols, int ld) {
+    double sum, squares;
+    uint64_t hash;
+    checksumTerms(data, rows, cols, ld, 0, &sum, &squares, &hash);
+    printChecksumLine((long)rows * cols, sum, squares, hash);
+}
+
+// Function to write bytes to fd, retrying short writes; returns 0 on success, -1 on error
+static inline int writeAll(int fd, const char* bytes, size_t count) {
+    while (count > 0) {
+        ssize_t written = write(fd, bytes, count);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        bytes += written;
+        count -= (size_t)written;
+    }
+    return 0;
+}
+
+// Function to write a rows x cols result as raw doubles to path (standard output when path is NULL).
+// Padded rows are packed first so the whole result goes out in one write.
+static inline int writeBinary(const char* path, const double* data, int rows, int cols, int ld) {
+    size_t count = (size_t)rows * cols;
+    double* packed = NULL;
+    if (ld != cols) {
+        packed = allocAligned(count);
+        if (packed == NULL) {
+            fprintf(stderr, "Memory allocation failed for the binary output.\n");
+            return -1;
+        }
+        for (int i = 0; i < rows; i++) {
+            memcpy(packed + (size_t)i * cols, data + (size_t)i * ld, cols * sizeof(double));
+        }
+        data = packed;
+    }
+    int fd = path == NULL ? STDOUT_FILENO : open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    int status = fd < 0 ? -1 : writeAll(fd, (const char*)data, count * sizeof(double));
+    if (status != 0) {
+        fprintf(stderr, "Error: could not write the result to %s: %s\n", path == NULL ? "standard output" : path,
+                strerror(errno));
+    }
+    if (path != NULL && fd >= 0 && close(fd) != 0 && status == 0) {
+        fprintf(stderr, "Error: could not write the result to %s: %s\n", path, strerror(errno));
+        status = -1;
+    }
+    free(packed);
+    return status;
+}
+
+// Function to report on standard error how long repeat executions of a rows x cols multiplication
+// took; nothing is printed for a single execution
+static inline void printRepeatTiming(int repeat, double seconds, int rows, int cols) {
+    if (repeat <= 1) {
+        return;
+    }
+    double each = seconds / repeat;
+    fprintf(stderr, "Executed %d multiplications in %.6f s (%.6f s each, %.2f GFLOP/s)\n", repeat, seconds, each,
+            each > 0.0 ? 2.0 * rows * (double)cols / each * 1e-9 : 0.0);
+}
+
+// Function to report on standard error how a power iteration ended: the steps taken, their time and the
+// last ||A x||, the estimate of the magnitude of the dominant eigenvalue
+static inline void printPowerIteration(int iterations, double seconds, double eigenvalue) {
+    fprintf(stderr, "Power iteration: %d steps in %.6f s (%.6f s each), dominant |eigenvalue| ~ %.17g\n", iterations,
+            seconds, seconds / iterations, eigenvalue);
+}
+
+// Function to output a rows x cols result (one column per vector) in the mode chosen on the command
+// line; returns 0 on success, -1 if the binary output could not be written
+static inline int outputResult(const Options* options, const double* data, int rows, int cols, int ld) {
+    switch (options->output) {
+    case OUTPUT_CHECKSUM:
+        printChecksum(data, rows, cols, ld);
+        return 0;
+    case OUTPUT_BINARY:
+        return writeBinary(options->outputFile, data, rows, cols, ld);
+    case OUTPUT_TEXT:
+        if (cols == 1) {
+            printf("Resulting vector:\n");
+            for (int i = 0; i < rows; i++) {
+                printf("%f\n", data[(size_t)i * ld]);
+            }
+        } else {
+            Matrix results = {(double*)data, rows, cols, ld};
+            printMatrix("Resulting vectors (one per column)", &results);
+        }
+        return 0;
+    default:
+        return 0;
+    }
+}
+
+#endif // MXV_OUTPUT_H
@@ -0,0 +1,171 @@
+/*
+ * Programmer(s) : Syed Saad Ullah Hussaini, K214703 Ali Raza, K213100 Muhammad Sameed
+ * Date: 17 October 2026
+ * Desc: Persistent execution plans for y = A * x. A plan is made once for a
+ *       matrix shape and an engine; it fixes the SIMD kernel, the thread team
+ *       size, the row band of every thread and the tile width, and owns the
+ *       tile buffers, so executing it (thousands of times in an iterative
+ *       solver) allocates and decides nothing.
+ *
+ *           MatvecPlan plan;
+ *           createMatvecPlan(&plan, ENGINE_TILED, rows, cols, 0, 0);
+ *           for (...) executeMatvecPlan(&plan, &matrix, x, y);
+ *           destroyMatvecPlan(&plan);
+ */
+
+#ifndef MXV_PLAN_H
+#define MXV_PLAN_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mXv_matrix.h"
+#include "mXv_simd.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+typedef enum {
+    ENGINE_SEQUENTIAL = 0, // One thread runs the SIMD kernel over all rows
+    ENGINE_OPENMP = 1,     // Every thread runs the SIMD kernel over its own row band
+    ENGINE_TILED = 2       // Every thread sweeps its row band one column tile at a time
+} MatvecEngine;
+
+typedef struct {
+    MatvecEngine engine;
+    int rows;
+    int cols;
+    int threads;       // Team size of every execution (1 for the sequential engine or without OpenMP)
+    int tileCols;      // Column tile width of the tiled engine, the full width otherwise
+    GemvKernel kernel;
+    int* bandStart;    // threads + 1 entries; thread t owns rows [bandStart[t], bandStart[t + 1])
+    double* buffers;   // Tiled engine: the partial and accumulated sums of every band, 2 * rows doubles
+} MatvecPlan;
+
+// Function to get the number of the calling thread inside a plan execution
+static inline int planThreadNum(void) {
+#ifdef _OPENMP
+    return omp_get_thread_num();
+#else
+    return 0;
+#endif
+}
+
+// Function to get the size of the team a plan execution actually got. num_threads is only a request:
+// with OMP_DYNAMIC or OMP_THREAD_LIMIT the team can be smaller than plan->threads, so every thread
+// takes bands planThreadNum(), planThreadNum() + planTeamSize(), ... until all bands are done.
+static inline int planTeamSize(void) {
+#ifdef _OPENMP
+    return omp_get_num_threads();
+#else
+    return 1;
+#endif
+}
+
+// Function to create a plan for rows x cols matrices. threads <= 0 takes the OpenMP default team
+// size; tileSize is the column tile width of the tiled engine, 0 picks one from the L2 cache.
+// Returns 0 on success, -1 if the buffers could not be allocated.
+static inline int createMatvecPlan(MatvecPlan* plan, MatvecEngine engine, int rows, int cols, int threads, int tileSize) {
+    memset(plan, 0, sizeof(*plan));
+    plan->engine = engine;
+    plan->rows = rows;
+    plan->cols = cols;
+    plan->kernel = selectGemvKernel();
+    plan->tileCols = engine == ENGINE_TILED ? chooseTileColumns(cols, tileSize) : cols;
+#ifdef _OPENMP
+    plan->threads = engine == ENGINE_SEQUENTIAL ? 1 : (threads > 0 ? threads : omp_get_max_threads());
+#else
+    (void)threads;
+    plan->threads = 1;
+#endif
+
+    plan->bandStart = (int*)malloc((plan->threads + 1) * sizeof(int));
+    if (plan->bandStart == NULL) {
+        return -1;
+    }
+    for (int t = 0; t < plan->threads; t++) {
+        int rowEnd;
+        rowBand(rows, plan->threads, t, &plan->bandStart[t], &rowEnd);
+    }
+    plan->bandStart[plan->threads] = rows;
+
+    if (engine == ENGINE_TILED) {
+        plan->buffers = allocAligned(2 * (size_t)rows);
+        if (plan->buffers == NULL) {
+            free(plan->bandStart);
+            plan->bandStart = NULL;
+            return -1;
+        }
+        // Every thread first touches its own buffers, so they sit on its NUMA node
+#ifdef _OPENMP
+        #pragma omp parallel num_threads(plan->threads) if (plan->threads > 1)
+#endif
+        for (int t = planThreadNum(); t < plan->threads; t += planTeamSize()) {
+            int bandRows = plan->bandStart[t + 1] - plan->bandStart[t];
+            memset(plan->buffers + 2 * (size_t)plan->bandStart[t], 0, 2 * (size_t)bandRows * sizeof(double));
+        }
+    }
+    return 0;
+}
+
+// Function to compute the band of thread t of a plan
+static inline void executeMatvecBand(const MatvecPlan* plan, const Matrix* matrix, const double* vector, double* result, int t) {
+    int rowBegin = plan->bandStart[t];
+    int rowEnd = plan->bandStart[t + 1];
+    if (plan->engine == ENGINE_TILED) {
+        double* partial = plan->buffers + 2 * (size_t)rowBegin;
+        gemvTiledBand(plan->kernel, matrix, vector, result, rowBegin, rowEnd, plan->tileCols, partial,
+                      partial + (rowEnd - rowBegin));
+    } else {
+        plan->kernel(matrix, vector, result, rowBegin, rowEnd);
+    }
+}
+
+// Function to execute a plan: result = matrix * vector. matrix must have the shape of the plan.
+static inline void executeMatvecPlan(const MatvecPlan* plan, const Matrix* matrix, const double* vector, double* result) {
+#ifdef _OPENMP
+    #pragma omp parallel num_threads(plan->threads) if (plan->threads > 1)
+#endif
+    for (int t = planThreadNum(); t < plan->threads; t += planTeamSize()) {
+        executeMatvecBand(plan, matrix, vector, result, t);
+    }
+}
+
+// Function to execute a plan on rows [rowBegin, rowEnd) only, split over the team like a whole matrix;
+// used to multiply a matrix chunk by chunk as it arrives. The rows give the same values as a full execution.
+static inline void executeMatvecRows(const MatvecPlan* plan, const Matrix* matrix, const double* vector, double* result,
+                                     int rowBegin, int rowEnd) {
+#ifdef _OPENMP
+    #pragma omp parallel num_threads(plan->threads) if (plan->threads > 1 && rowEnd - rowBegin >= plan->threads)
+#endif
+    {
+        int teamSize = 1;
+        int t = 0;
+#ifdef _OPENMP
+        teamSize = omp_get_num_threads();
+        t = omp_get_thread_num();
+#endif
+        int begin, end;
+        rowBand(rowEnd - rowBegin, teamSize, t, &begin, &end);
+        begin += rowBegin;
+        end += rowBegin;
+        if (plan->engine == ENGINE_TILED) {
+            // The buffers hold two doubles per row, so disjoint row ranges use disjoint buffers
+            double* partial = plan->buffers + 2 * (size_t)begin;
+            gemvTiledBand(plan->kernel, matrix, vector, result, begin, end, plan->tileCols, partial, partial + (end - begin));
+        } else if (end > begin) {
+            plan->kernel(matrix, vector, result, begin, end);
+        }
+    }
+}
+
+// Function to release the buffers of a plan
+static inline void destroyMatvecPlan(MatvecPlan* plan) {
+    free(plan->bandStart);
+    free(plan->buffers);
+    plan->bandStart = NULL;
+    plan->buffers = NULL;
+}
+
+#endif // MXV_PLAN_H
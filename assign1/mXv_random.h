@@ -0,0 +1,50 @@
+/*
+ * Programmer(s) : Syed Saad Ullah Hussaini, K214703 Ali Raza, K213100 Muhammad Sameed
+ * Date: 17 October 2026
+ * Desc: Counter-based random numbers for the mXv programs. Element (row, col)
+ *       of a random matrix is a pure function of the seed, a stream number and
+ *       the two indices (SplitMix64 finaliser applied to the counter), so any
+ *       thread or rank can generate any block on its own and the data is the
+ *       same whatever the thread count, rank count or engine.
+ */
+
+#ifndef MXV_RANDOM_H
+#define MXV_RANDOM_H
+
+#include <stdint.h>
+
+// Independent streams, so the matrix, the vectors and the sparsity pattern do not share values
+typedef enum { RANDOM_STREAM_MATRIX = 0, RANDOM_STREAM_VECTOR = 1, RANDOM_STREAM_PATTERN = 2 } RandomStream;
+
+// Seed used when --seed is not given
+#define RANDOM_DEFAULT_SEED 1
+
+// SplitMix64 finaliser: a bijective mix where every input bit affects every output bit
+static inline uint64_t splitMix64(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+// Function to derive the key of one stream from the user seed
+static inline uint64_t randomKey(uint64_t seed, RandomStream stream) {
+    return splitMix64(splitMix64(seed) ^ (uint64_t)stream);
+}
+
+// Function to get 64 random bits for (row, col) of the stream with the given key
+static inline uint64_t randomBits(uint64_t key, uint64_t row, uint64_t col) {
+    return splitMix64(key ^ splitMix64((row << 32) | (col & 0xffffffffULL)));
+}
+
+// Function to get a uniform double in [0, 1) for (row, col)
+static inline double randomUniform(uint64_t key, uint64_t row, uint64_t col) {
+    return (randomBits(key, row, col) >> 11) * 0x1.0p-53;
+}
+
+// Function to get a uniform double in (0, 1] for (row, col), safe to pass to log()
+static inline double randomUniformOpen(uint64_t key, uint64_t row, uint64_t col) {
+    return ((randomBits(key, row, col) >> 11) + 1) * 0x1.0p-53;
+}
+
+#endif // MXV_RANDOM_H
@@ -0,0 +1,544 @@
+/*
+ * Programmer(s) : Syed Saad Ullah Hussaini, K214703 Ali Raza, K213100 Muhammad Sameed
+ * Date: 17 October 2026
+ * Desc: Explicitly vectorised matrix vector kernels (scalar, SSE2, AVX2 and AVX-512)
+ *       with the best one picked at runtime from CPUID. Every kernel works on
+ *       four rows at a time so each load of the vector is reused four times,
+ *       keeps several independent accumulators per row in registers and only
+ *       stores the finished dot products.
+ *       The batch kernels multiply the matrix by a block of k vectors at once:
+ *       every loaded matrix element is broadcast against up to 16 vectors, so a
+ *       single pass over the matrix serves the whole block.
+ *       Set MXV_SIMD=scalar|sse2|avx2|avx512 to force a particular kernel.
+ */
+
+#ifndef MXV_SIMD_H
+#define MXV_SIMD_H
+
+#include <string.h>
+#include <unistd.h>
+#include "mXv_matrix.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MXV_X86 1
+#endif
+
+// A kernel computes result[i] = row i of the matrix . vector for rowBegin <= i < rowEnd
+typedef void (*GemvKernel)(const Matrix* matrix, const double* vector, double* result, int rowBegin, int rowEnd);
+
+// Portable kernel, also used for the leftover rows by some of the SIMD kernels
+static void gemvScalar(const Matrix* matrix, const double* vector, double* result, int rowBegin, int rowEnd) {
+    int cols = matrix->cols;
+    int i = rowBegin;
+    for (; i + 4 <= rowEnd; i += 4) {
+        const double* r0 = MATRIX_ROW(matrix, i);
+        const double* r1 = MATRIX_ROW(matrix, i + 1);
+        const double* r2 = MATRIX_ROW(matrix, i + 2);
+        const double* r3 = MATRIX_ROW(matrix, i + 3);
+        double s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0;
+        for (int j = 0; j < cols; j++) {
+            double x = vector[j];
+            s0 += r0[j] * x;
+            s1 += r1[j] * x;
+            s2 += r2[j] * x;
+            s3 += r3[j] * x;
+        }
+        result[i] = s0;
+        result[i + 1] = s1;
+        result[i + 2] = s2;
+        result[i + 3] = s3;
+    }
+    for (; i < rowEnd; i++) {
+        const double* row = MATRIX_ROW(matrix, i);
+        double s0 = 0.0, s1 = 0.0;
+        int j = 0;
+        for (; j + 2 <= cols; j += 2) {
+            s0 += row[j] * vector[j];
+            s1 += row[j + 1] * vector[j + 1];
+        }
+        for (; j < cols; j++) {
+            s0 += row[j] * vector[j];
+        }
+        result[i] = s0 + s1;
+    }
+}
+
+// A batch kernel computes rows [rowBegin, rowEnd) of results = matrix * vectors, where vectors holds
+// one right-hand side per column (cols x k) and results is rows x k. vectors and results must share
+// the same leading dimension and the padding columns of vectors must be zero.
+typedef void (*GemvBatchKernel)(const Matrix* matrix, const Matrix* vectors, Matrix* results, int rowBegin, int rowEnd);
+
+// Columns of the matrix visited per pass of a batch kernel; 4 rows of this width stay in L1
+// while every block of right-hand sides is swept over them
+#define BATCH_TILE_COLS 512
+
+// Portable batch kernel: 4 rows x 4 right-hand sides per block, also used for leftover rows
+static void gemvBatchScalar(const Matrix* matrix, const Matrix* vectors, Matrix* results, int rowBegin, int rowEnd) {
+    int cols = matrix->cols;
+    int width = vectors->ld;
+    for (int i = rowBegin; i < rowEnd; i += 4) {
+        int blockRows = rowEnd - i < 4 ? rowEnd - i : 4;
+        for (int colBegin = 0; colBegin < cols; colBegin += BATCH_TILE_COLS) {
+            int colEnd = colBegin + BATCH_TILE_COLS < cols ? colBegin + BATCH_TILE_COLS : cols;
+            for (int kb = 0; kb < width; kb += 4) {
+                double acc[4][4] = {{0.0}};
+                for (int r = 0; r < blockRows && colBegin > 0; r++) {
+                    for (int v = 0; v < 4; v++) {
+                        acc[r][v] = MATRIX_ROW(results, i + r)[kb + v];
+                    }
+                }
+                for (int j = colBegin; j < colEnd; j++) {
+                    const double* x = MATRIX_ROW(vectors, j) + kb;
+                    for (int r = 0; r < blockRows; r++) {
+                        double a = MATRIX_AT(matrix, i + r, j);
+                        for (int v = 0; v < 4; v++) {
+                            acc[r][v] += a * x[v];
+                        }
+                    }
+                }
+                for (int r = 0; r < blockRows; r++) {
+                    for (int v = 0; v < 4; v++) {
+                        MATRIX_ROW(results, i + r)[kb + v] = acc[r][v];
+                    }
+                }
+            }
+        }
+    }
+}
+
+#ifdef MXV_X86
+
+// Horizontal sum of the two lanes of an SSE2 register
+static inline double hsumSse2(__m128d v) {
+    return _mm_cvtsd_f64(_mm_add_sd(v, _mm_unpackhi_pd(v, v)));
+}
+
+// SSE2 kernel: 4 rows x 2 accumulators of 2 doubles
+__attribute__((target("sse2")))
+static void gemvSse2(const Matrix* matrix, const double* vector, double* result, int rowBegin, int rowEnd) {
+    int cols = matrix->cols;
+    int i = rowBegin;
+    for (; i + 4 <= rowEnd; i += 4) {
+        const double* r[4] = {MATRIX_ROW(matrix, i), MATRIX_ROW(matrix, i + 1), MATRIX_ROW(matrix, i + 2), MATRIX_ROW(matrix, i + 3)};
+        __m128d acc[4][2];
+        for (int k = 0; k < 4; k++) {
+            acc[k][0] = _mm_setzero_pd();
+            acc[k][1] = _mm_setzero_pd();
+        }
+        int j = 0;
+        for (; j + 4 <= cols; j += 4) {
+            __m128d x0 = _mm_loadu_pd(vector + j);
+            __m128d x1 = _mm_loadu_pd(vector + j + 2);
+            for (int k = 0; k < 4; k++) {
+                acc[k][0] = _mm_add_pd(acc[k][0], _mm_mul_pd(_mm_loadu_pd(r[k] + j), x0));
+                acc[k][1] = _mm_add_pd(acc[k][1], _mm_mul_pd(_mm_loadu_pd(r[k] + j + 2), x1));
+            }
+        }
+        for (int k = 0; k < 4; k++) {
+            double sum = hsumSse2(_mm_add_pd(acc[k][0], acc[k][1]));
+            for (int l = j; l < cols; l++) {
+                sum += r[k][l] * vector[l];
+            }
+            result[i + k] = sum;
+        }
+    }
+    for (; i < rowEnd; i++) {
+        const double* row = MATRIX_ROW(matrix, i);
+        __m128d a0 = _mm_setzero_pd(), a1 = _mm_setzero_pd();
+        int j = 0;
+        for (; j + 4 <= cols; j += 4) {
+            a0 = _mm_add_pd(a0, _mm_mul_pd(_mm_loadu_pd(row + j), _mm_loadu_pd(vector + j)));
+            a1 = _mm_add_pd(a1, _mm_mul_pd(_mm_loadu_pd(row + j + 2), _mm_loadu_pd(vector + j + 2)));
+        }
+        double sum = hsumSse2(_mm_add_pd(a0, a1));
+        for (; j < cols; j++) {
+            sum += row[j] * vector[j];
+        }
+        result[i] = sum;
+    }
+}
+
+// Reduce four AVX registers to one register holding their four horizontal sums
+__attribute__((target("avx2")))
+static inline __m256d hsum4Avx(__m256d s0, __m256d s1, __m256d s2, __m256d s3) {
+    __m256d t0 = _mm256_hadd_pd(s0, s1); // s0[0]+s0[1], s1[0]+s1[1], s0[2]+s0[3], s1[2]+s1[3]
+    __m256d t1 = _mm256_hadd_pd(s2, s3);
+    __m256d lo = _mm256_permute2f128_pd(t0, t1, 0x20);
+    __m256d hi = _mm256_permute2f128_pd(t0, t1, 0x31);
+    return _mm256_add_pd(lo, hi);
+}
+
+// AVX2 kernel: 4 rows x 2 FMA accumulators of 4 doubles
+__attribute__((target("avx2,fma")))
+static void gemvAvx2(const Matrix* matrix, const double* vector, double* result, int rowBegin, int rowEnd) {
+    int cols = matrix->cols;
+    int i = rowBegin;
+    for (; i + 4 <= rowEnd; i += 4) {
+        const double* r0 = MATRIX_ROW(matrix, i);
+        const double* r1 = MATRIX_ROW(matrix, i + 1);
+        const double* r2 = MATRIX_ROW(matrix, i + 2);
+        const double* r3 = MATRIX_ROW(matrix, i + 3);
+        __m256d a00 = _mm256_setzero_pd(), a01 = _mm256_setzero_pd();
+        __m256d a10 = _mm256_setzero_pd(), a11 = _mm256_setzero_pd();
+        __m256d a20 = _mm256_setzero_pd(), a21 = _mm256_setzero_pd();
+        __m256d a30 = _mm256_setzero_pd(), a31 = _mm256_setzero_pd();
+        int j = 0;
+        for (; j + 8 <= cols; j += 8) {
+            __m256d x0 = _mm256_loadu_pd(vector + j);
+            __m256d x1 = _mm256_loadu_pd(vector + j + 4);
+            a00 = _mm256_fmadd_pd(_mm256_loadu_pd(r0 + j), x0, a00);
+            a01 = _mm256_fmadd_pd(_mm256_loadu_pd(r0 + j + 4), x1, a01);
+            a10 = _mm256_fmadd_pd(_mm256_loadu_pd(r1 + j), x0, a10);
+            a11 = _mm256_fmadd_pd(_mm256_loadu_pd(r1 + j + 4), x1, a11);
+            a20 = _mm256_fmadd_pd(_mm256_loadu_pd(r2 + j), x0, a20);
+            a21 = _mm256_fmadd_pd(_mm256_loadu_pd(r2 + j + 4), x1, a21);
+            a30 = _mm256_fmadd_pd(_mm256_loadu_pd(r3 + j), x0, a30);
+            a31 = _mm256_fmadd_pd(_mm256_loadu_pd(r3 + j + 4), x1, a31);
+        }
+        if (j + 4 <= cols) {
+            __m256d x0 = _mm256_loadu_pd(vector + j);
+            a00 = _mm256_fmadd_pd(_mm256_loadu_pd(r0 + j), x0, a00);
+            a10 = _mm256_fmadd_pd(_mm256_loadu_pd(r1 + j), x0, a10);
+            a20 = _mm256_fmadd_pd(_mm256_loadu_pd(r2 + j), x0, a20);
+            a30 = _mm256_fmadd_pd(_mm256_loadu_pd(r3 + j), x0, a30);
+            j += 4;
+        }
+        double sums[4];
+        _mm256_storeu_pd(sums, hsum4Avx(_mm256_add_pd(a00, a01), _mm256_add_pd(a10, a11),
+                                        _mm256_add_pd(a20, a21), _mm256_add_pd(a30, a31)));
+        for (; j < cols; j++) {
+            double x = vector[j];
+            sums[0] += r0[j] * x;
+            sums[1] += r1[j] * x;
+            sums[2] += r2[j] * x;
+            sums[3] += r3[j] * x;
+        }
+        result[i] = sums[0];
+        result[i + 1] = sums[1];
+        result[i + 2] = sums[2];
+        result[i + 3] = sums[3];
+    }
+    for (; i < rowEnd; i++) {
+        const double* row = MATRIX_ROW(matrix, i);
+        __m256d a0 = _mm256_setzero_pd(), a1 = _mm256_setzero_pd();
+        int j = 0;
+        for (; j + 8 <= cols; j += 8) {
+            a0 = _mm256_fmadd_pd(_mm256_loadu_pd(row + j), _mm256_loadu_pd(vector + j), a0);
+            a1 = _mm256_fmadd_pd(_mm256_loadu_pd(row + j + 4), _mm256_loadu_pd(vector + j + 4), a1);
+        }
+        __m256d s = _mm256_add_pd(a0, a1);
+        __m128d h = _mm_add_pd(_mm256_castpd256_pd128(s), _mm256_extractf128_pd(s, 1));
+        double sum = _mm_cvtsd_f64(_mm_add_sd(h, _mm_unpackhi_pd(h, h)));
+        for (; j < cols; j++) {
+            sum += row[j] * vector[j];
+        }
+        result[i] = sum;
+    }
+}
+
+// AVX-512 kernel: 4 rows x 2 FMA accumulators of 8 doubles, masked loads for the column tail
+__attribute__((target("avx512f")))
+static void gemvAvx512(const Matrix* matrix, const double* vector, double* result, int rowBegin, int rowEnd) {
+    int cols = matrix->cols;
+    int tail = cols % 8;
+    int body = cols - tail;
+    __mmask8 tailMask = (__mmask8)((1u << tail) - 1);
+    int i = rowBegin;
+    for (; i + 4 <= rowEnd; i += 4) {
+        const double* r0 = MATRIX_ROW(matrix, i);
+        const double* r1 = MATRIX_ROW(matrix, i + 1);
+        const double* r2 = MATRIX_ROW(matrix, i + 2);
+        const double* r3 = MATRIX_ROW(matrix, i + 3);
+        __m512d a00 = _mm512_setzero_pd(), a01 = _mm512_setzero_pd();
+        __m512d a10 = _mm512_setzero_pd(), a11 = _mm512_setzero_pd();
+        __m512d a20 = _mm512_setzero_pd(), a21 = _mm512_setzero_pd();
+        __m512d a30 = _mm512_setzero_pd(), a31 = _mm512_setzero_pd();
+        int j = 0;
+        for (; j + 16 <= body; j += 16) {
+            __m512d x0 = _mm512_loadu_pd(vector + j);
+            __m512d x1 = _mm512_loadu_pd(vector + j + 8);
+            a00 = _mm512_fmadd_pd(_mm512_loadu_pd(r0 + j), x0, a00);
+            a01 = _mm512_fmadd_pd(_mm512_loadu_pd(r0 + j + 8), x1, a01);
+            a10 = _mm512_fmadd_pd(_mm512_loadu_pd(r1 + j), x0, a10);
+            a11 = _mm512_fmadd_pd(_mm512_loadu_pd(r1 + j + 8), x1, a11);
+            a20 = _mm512_fmadd_pd(_mm512_loadu_pd(r2 + j), x0, a20);
+            a21 = _mm512_fmadd_pd(_mm512_loadu_pd(r2 + j + 8), x1, a21);
+            a30 = _mm512_fmadd_pd(_mm512_loadu_pd(r3 + j), x0, a30);
+            a31 = _mm512_fmadd_pd(_mm512_loadu_pd(r3 + j + 8), x1, a31);
+        }
+        if (j < body) {
+            __m512d x0 = _mm512_loadu_pd(vector + j);
+            a00 = _mm512_fmadd_pd(_mm512_loadu_pd(r0 + j), x0, a00);
+            a10 = _mm512_fmadd_pd(_mm512_loadu_pd(r1 + j), x0, a10);
+            a20 = _mm512_fmadd_pd(_mm512_loadu_pd(r2 + j), x0, a20);
+            a30 = _mm512_fmadd_pd(_mm512_loadu_pd(r3 + j), x0, a30);
+        }
+        if (tail) {
+            __m512d x1 = _mm512_maskz_loadu_pd(tailMask, vector + body);
+            a01 = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(tailMask, r0 + body), x1, a01);
+            a11 = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(tailMask, r1 + body), x1, a11);
+            a21 = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(tailMask, r2 + body), x1, a21);
+            a31 = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(tailMask, r3 + body), x1, a31);
+        }
+        result[i] = _mm512_reduce_add_pd(_mm512_add_pd(a00, a01));
+        result[i + 1] = _mm512_reduce_add_pd(_mm512_add_pd(a10, a11));
+        result[i + 2] = _mm512_reduce_add_pd(_mm512_add_pd(a20, a21));
+        result[i + 3] = _mm512_reduce_add_pd(_mm512_add_pd(a30, a31));
+    }
+    for (; i < rowEnd; i++) {
+        const double* row = MATRIX_ROW(matrix, i);
+        __m512d a0 = _mm512_setzero_pd(), a1 = _mm512_setzero_pd();
+        int j = 0;
+        for (; j + 16 <= body; j += 16) {
+            a0 = _mm512_fmadd_pd(_mm512_loadu_pd(row + j), _mm512_loadu_pd(vector + j), a0);
+            a1 = _mm512_fmadd_pd(_mm512_loadu_pd(row + j + 8), _mm512_loadu_pd(vector + j + 8), a1);
+        }
+        if (j < body) {
+            a0 = _mm512_fmadd_pd(_mm512_loadu_pd(row + j), _mm512_loadu_pd(vector + j), a0);
+        }
+        if (tail) {
+            a1 = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(tailMask, row + body), _mm512_maskz_loadu_pd(tailMask, vector + body), a1);
+        }
+        result[i] = _mm512_reduce_add_pd(_mm512_add_pd(a0, a1));
+    }
+}
+
+// SSE2 batch kernel: 4 rows x 4 right-hand sides (2 registers per row) per block
+__attribute__((target("sse2")))
+static void gemvBatchSse2(const Matrix* matrix, const Matrix* vectors, Matrix* results, int rowBegin, int rowEnd) {
+    int cols = matrix->cols;
+    int width = vectors->ld;
+    int i = rowBegin;
+    for (; i + 4 <= rowEnd; i += 4) {
+        const double* a[4] = {MATRIX_ROW(matrix, i), MATRIX_ROW(matrix, i + 1), MATRIX_ROW(matrix, i + 2), MATRIX_ROW(matrix, i + 3)};
+        double* y[4] = {MATRIX_ROW(results, i), MATRIX_ROW(results, i + 1), MATRIX_ROW(results, i + 2), MATRIX_ROW(results, i + 3)};
+        for (int colBegin = 0; colBegin < cols; colBegin += BATCH_TILE_COLS) {
+            int colEnd = colBegin + BATCH_TILE_COLS < cols ? colBegin + BATCH_TILE_COLS : cols;
+            for (int kb = 0; kb < width; kb += 4) {
+                __m128d acc[4][2];
+                for (int r = 0; r < 4; r++) {
+                    acc[r][0] = colBegin > 0 ? _mm_load_pd(y[r] + kb) : _mm_setzero_pd();
+                    acc[r][1] = colBegin > 0 ? _mm_load_pd(y[r] + kb + 2) : _mm_setzero_pd();
+                }
+                for (int j = colBegin; j < colEnd; j++) {
+                    const double* x = MATRIX_ROW(vectors, j) + kb;
+                    __m128d x0 = _mm_load_pd(x);
+                    __m128d x1 = _mm_load_pd(x + 2);
+                    for (int r = 0; r < 4; r++) {
+                        __m128d av = _mm_set1_pd(a[r][j]);
+                        acc[r][0] = _mm_add_pd(acc[r][0], _mm_mul_pd(av, x0));
+                        acc[r][1] = _mm_add_pd(acc[r][1], _mm_mul_pd(av, x1));
+                    }
+                }
+                for (int r = 0; r < 4; r++) {
+                    _mm_store_pd(y[r] + kb, acc[r][0]);
+                    _mm_store_pd(y[r] + kb + 2, acc[r][1]);
+                }
+            }
+        }
+    }
+    gemvBatchScalar(matrix, vectors, results, i, rowEnd);
+}
+
+// AVX2 batch kernel: 4 rows x 8 right-hand sides (2 FMA registers per row) per block
+__attribute__((target("avx2,fma")))
+static void gemvBatchAvx2(const Matrix* matrix, const Matrix* vectors, Matrix* results, int rowBegin, int rowEnd) {
+    int cols = matrix->cols;
+    int width = vectors->ld;
+    int i = rowBegin;
+    for (; i + 4 <= rowEnd; i += 4) {
+        const double* a[4] = {MATRIX_ROW(matrix, i), MATRIX_ROW(matrix, i + 1), MATRIX_ROW(matrix, i + 2), MATRIX_ROW(matrix, i + 3)};
+        double* y[4] = {MATRIX_ROW(results, i), MATRIX_ROW(results, i + 1), MATRIX_ROW(results, i + 2), MATRIX_ROW(results, i + 3)};
+        for (int colBegin = 0; colBegin < cols; colBegin += BATCH_TILE_COLS) {
+            int colEnd = colBegin + BATCH_TILE_COLS < cols ? colBegin + BATCH_TILE_COLS : cols;
+            for (int kb = 0; kb < width; kb += 8) {
+                __m256d acc[4][2];
+                for (int r = 0; r < 4; r++) {
+                    acc[r][0] = colBegin > 0 ? _mm256_load_pd(y[r] + kb) : _mm256_setzero_pd();
+                    acc[r][1] = colBegin > 0 ? _mm256_load_pd(y[r] + kb + 4) : _mm256_setzero_pd();
+                }
+                for (int j = colBegin; j < colEnd; j++) {
+                    const double* x = MATRIX_ROW(vectors, j) + kb;
+                    __m256d x0 = _mm256_load_pd(x);
+                    __m256d x1 = _mm256_load_pd(x + 4);
+                    for (int r = 0; r < 4; r++) {
+                        __m256d av = _mm256_broadcast_sd(a[r] + j);
+                        acc[r][0] = _mm256_fmadd_pd(av, x0, acc[r][0]);
+                        acc[r][1] = _mm256_fmadd_pd(av, x1, acc[r][1]);
+                    }
+                }
+                for (int r = 0; r < 4; r++) {
+                    _mm256_store_pd(y[r] + kb, acc[r][0]);
+                    _mm256_store_pd(y[r] + kb + 4, acc[r][1]);
+                }
+            }
+        }
+    }
+    gemvBatchScalar(matrix, vectors, results, i, rowEnd);
+}
+
+// AVX-512 batch kernel: 4 rows x 16 right-hand sides (2 FMA registers per row) per block,
+// with a 4 rows x 8 block for the last eight columns when the width is not a multiple of 16
+__attribute__((target("avx512f")))
+static void gemvBatchAvx512(const Matrix* matrix, const Matrix* vectors, Matrix* results, int rowBegin, int rowEnd) {
+    int cols = matrix->cols;
+    int width = vectors->ld;
+    int i = rowBegin;
+    for (; i + 4 <= rowEnd; i += 4) {
+        const double* a[4] = {MATRIX_ROW(matrix, i), MATRIX_ROW(matrix, i + 1), MATRIX_ROW(matrix, i + 2), MATRIX_ROW(matrix, i + 3)};
+        double* y[4] = {MATRIX_ROW(results, i), MATRIX_ROW(results, i + 1), MATRIX_ROW(results, i + 2), MATRIX_ROW(results, i + 3)};
+        for (int colBegin = 0; colBegin < cols; colBegin += BATCH_TILE_COLS) {
+            int colEnd = colBegin + BATCH_TILE_COLS < cols ? colBegin + BATCH_TILE_COLS : cols;
+            int kb = 0;
+            for (; kb + 16 <= width; kb += 16) {
+                __m512d acc[4][2];
+                for (int r = 0; r < 4; r++) {
+                    acc[r][0] = colBegin > 0 ? _mm512_load_pd(y[r] + kb) : _mm512_setzero_pd();
+                    acc[r][1] = colBegin > 0 ? _mm512_load_pd(y[r] + kb + 8) : _mm512_setzero_pd();
+                }
+                for (int j = colBegin; j < colEnd; j++) {
+                    const double* x = MATRIX_ROW(vectors, j) + kb;
+                    __m512d x0 = _mm512_load_pd(x);
+                    __m512d x1 = _mm512_load_pd(x + 8);
+                    for (int r = 0; r < 4; r++) {
+                        __m512d av = _mm512_set1_pd(a[r][j]);
+                        acc[r][0] = _mm512_fmadd_pd(av, x0, acc[r][0]);
+                        acc[r][1] = _mm512_fmadd_pd(av, x1, acc[r][1]);
+                    }
+                }
+                for (int r = 0; r < 4; r++) {
+                    _mm512_store_pd(y[r] + kb, acc[r][0]);
+                    _mm512_store_pd(y[r] + kb + 8, acc[r][1]);
+                }
+            }
+            if (kb < width) {
+                __m512d acc[4];
+                for (int r = 0; r < 4; r++) {
+                    acc[r] = colBegin > 0 ? _mm512_load_pd(y[r] + kb) : _mm512_setzero_pd();
+                }
+                for (int j = colBegin; j < colEnd; j++) {
+                    __m512d x0 = _mm512_load_pd(MATRIX_ROW(vectors, j) + kb);
+                    for (int r = 0; r < 4; r++) {
+                        acc[r] = _mm512_fmadd_pd(_mm512_set1_pd(a[r][j]), x0, acc[r]);
+                    }
+                }
+                for (int r = 0; r < 4; r++) {
+                    _mm512_store_pd(y[r] + kb, acc[r]);
+                }
+            }
+        }
+    }
+    gemvBatchScalar(matrix, vectors, results, i, rowEnd);
+}
+
+#endif // MXV_X86
+
+typedef struct {
+    const char* name;
+    GemvKernel kernel;
+    GemvBatchKernel batchKernel;
+} GemvKernelInfo;
+
+// Function to pick the widest kernel the CPU supports (or the one named in MXV_SIMD)
+static const GemvKernelInfo* selectGemvKernelInfo(void) {
+    static const GemvKernelInfo kernels[] = {
+#ifdef MXV_X86
+        {"avx512", gemvAvx512, gemvBatchAvx512},
+        {"avx2", gemvAvx2, gemvBatchAvx2},
+        {"sse2", gemvSse2, gemvBatchSse2},
+#endif
+        {"scalar", gemvScalar, gemvBatchScalar},
+    };
+    static const GemvKernelInfo* selected = NULL;
+    if (selected != NULL) {
+        return selected;
+    }
+
+    int count = sizeof(kernels) / sizeof(kernels[0]);
+    int supported[sizeof(kernels) / sizeof(kernels[0])];
+    for (int k = 0; k < count; k++) {
+        supported[k] = 1;
+    }
+#ifdef MXV_X86
+    __builtin_cpu_init();
+    supported[0] = __builtin_cpu_supports("avx512f");
+    supported[1] = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    supported[2] = __builtin_cpu_supports("sse2");
+#endif
+
+    const char* forced = getenv("MXV_SIMD");
+    for (int k = 0; k < count && forced != NULL; k++) {
+        if (strcmp(forced, kernels[k].name) == 0 && supported[k]) {
+            selected = &kernels[k];
+            return selected;
+        }
+    }
+    for (int k = 0; k < count; k++) {
+        if (supported[k]) {
+            selected = &kernels[k];
+            break;
+        }
+    }
+    return selected;
+}
+
+// Function returning the dispatched kernel
+static inline GemvKernel selectGemvKernel(void) {
+    return selectGemvKernelInfo()->kernel;
+}
+
+// Function returning the dispatched batch kernel
+static inline GemvBatchKernel selectGemvBatchKernel(void) {
+    return selectGemvKernelInfo()->batchKernel;
+}
+
+// Function to pick the column tile width: tileSize rounded up to whole cache lines of the
+// vector, or (for tileSize <= 0) a width whose slice of the vector fills a quarter of L2
+static inline int chooseTileColumns(int cols, int tileSize) {
+    int perLine = MATRIX_ALIGNMENT / sizeof(double);
+    if (tileSize <= 0) {
+        long l2Bytes = 0;
+#ifdef _SC_LEVEL2_CACHE_SIZE
+        l2Bytes = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#endif
+        if (l2Bytes <= 0) {
+            l2Bytes = 256 * 1024;
+        }
+        tileSize = (int)(l2Bytes / 4 / sizeof(double));
+    }
+    tileSize = (tileSize + perLine - 1) / perLine * perLine;
+    return tileSize < cols ? tileSize : cols;
+}
+
+// Function for cache-blocked multiplication of rows [rowBegin, rowEnd): the band is swept one
+// column tile at a time so the matching slice of the vector stays in cache while the rows
+// stream past it. Per-tile dot products land in partial and are summed into the private
+// accumulator acc; result is written once per row at the end. partial and acc must hold
+// rowEnd - rowBegin doubles.
+static inline void gemvTiledBand(GemvKernel kernel, const Matrix* matrix, const double* vector, double* result,
+                          int rowBegin, int rowEnd, int tileCols, double* partial, double* acc) {
+    int bandRows = rowEnd - rowBegin;
+    if (bandRows <= 0) {
+        return;
+    }
+    memset(acc, 0, bandRows * sizeof(double));
+    for (int colBegin = 0; colBegin < matrix->cols; colBegin += tileCols) {
+        int colEnd = colBegin + tileCols < matrix->cols ? colBegin + tileCols : matrix->cols;
+
+        // View of the rows of the band restricted to this column tile
+        Matrix tile;
+        tile.data = MATRIX_ROW(matrix, rowBegin) + colBegin;
+        tile.rows = bandRows;
+        tile.cols = colEnd - colBegin;
+        tile.ld = matrix->ld;
+
+        kernel(&tile, vector + colBegin, partial, 0, bandRows);
+        for (int i = 0; i < bandRows; i++) {
+            acc[i] += partial[i];
+        }
+    }
+    memcpy(result + rowBegin, acc, bandRows * sizeof(double));
+}
+
+#endif // MXV_SIMD_H
@@ -0,0 +1,508 @@
+/*
+ * Programmer(s) : Syed Saad Ullah Hussaini, K214703 Ali Raza, K213100 Muhammad Sameed
+ * Date: 17 October 2026
+ * Desc: Sparse matrix storage and sparse matrix vector kernels.
+ *       CSR keeps the nonzeros of each row contiguously. SELL-C-sigma groups
+ *       rows into chunks of SELL_CHUNK_HEIGHT, sorts rows by length inside
+ *       windows of sigma rows and stores each chunk column by column, so one
+ *       SIMD register handles the same position of SELL_CHUNK_HEIGHT rows.
+ *       Memory and time scale with the number of nonzeros, not rows * cols.
+ */
+
+#ifndef MXV_SPARSE_H
+#define MXV_SPARSE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "mXv_matrix.h"
+#include "mXv_simd.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Rows per SELL chunk: one AVX-512 register of doubles
+#define SELL_CHUNK_HEIGHT 8
+
+typedef enum {
+    SPARSE_NONE = 0, // Dense storage
+    SPARSE_CSR,
+    SPARSE_SELL
+} SparseFormat;
+
+typedef struct {
+    int rows;
+    int cols;
+    long nnz;
+    long* rowPtr;    // rows + 1 offsets into colIdx / values
+    int* colIdx;
+    double* values;
+} CsrMatrix;
+
+typedef struct {
+    int rows;
+    int cols;
+    int sigma;       // Rows are sorted by length within windows of this many rows
+    int numChunks;
+    long* chunkPtr;  // numChunks + 1 offsets into colIdx / values
+    int* chunkWidth; // Longest row of each chunk
+    int* rowPerm;    // rowPerm[slot] = original row stored at that slot, -1 for padding slots
+    int* colIdx;     // Entry k of slot r of chunk c lives at chunkPtr[c] + k * SELL_CHUNK_HEIGHT + r
+    double* values;
+} SellMatrix;
+
+typedef struct {
+    SparseFormat format;
+    CsrMatrix csr;   // Always filled in
+    SellMatrix sell; // Only filled in when format == SPARSE_SELL
+} SparseMatrix;
+
+// Function to allocate an empty CSR matrix with room for nnz nonzeros; pointers are NULL on failure
+static inline CsrMatrix allocCsr(int rows, int cols, long nnz) {
+    CsrMatrix csr;
+    csr.rows = rows;
+    csr.cols = cols;
+    csr.nnz = nnz;
+    csr.rowPtr = (long*)malloc((rows + 1) * sizeof(long));
+    csr.colIdx = (int*)malloc((nnz > 0 ? nnz : 1) * sizeof(int));
+    csr.values = allocAligned(nnz);
+    return csr;
+}
+
+// Function to release the storage of a CSR matrix
+static inline void freeCsr(CsrMatrix* csr) {
+    free(csr->rowPtr);
+    free(csr->colIdx);
+    free(csr->values);
+    csr->rowPtr = NULL;
+    csr->colIdx = NULL;
+    csr->values = NULL;
+}
+
+// Function to convert a dense matrix into CSR, keeping only the nonzero entries
+static inline CsrMatrix csrFromDense(const Matrix* matrix) {
+    long nnz = 0;
+    for (int i = 0; i < matrix->rows; i++) {
+        const double* row = MATRIX_ROW(matrix, i);
+        for (int j = 0; j < matrix->cols; j++) {
+            nnz += row[j] != 0.0;
+        }
+    }
+    CsrMatrix csr = allocCsr(matrix->rows, matrix->cols, nnz);
+    if (csr.rowPtr == NULL || csr.colIdx == NULL || csr.values == NULL) {
+        freeCsr(&csr);
+        return csr;
+    }
+    long k = 0;
+    for (int i = 0; i < matrix->rows; i++) {
+        const double* row = MATRIX_ROW(matrix, i);
+        csr.rowPtr[i] = k;
+        for (int j = 0; j < matrix->cols; j++) {
+            if (row[j] != 0.0) {
+                csr.colIdx[k] = j;
+                csr.values[k] = row[j];
+                k++;
+            }
+        }
+    }
+    csr.rowPtr[matrix->rows] = k;
+    return csr;
+}
+
+// Function to walk the nonzeros of row i of a random sparse matrix. The gap to the next nonzero is
+// drawn from a geometric distribution, so the cost is O(nnz of the row). Columns and values are only
+// written when colIdx is not NULL; returns the number of nonzeros of the row.
+static inline long randomCsrRow(uint64_t key, uint64_t patternKey, int i, int cols, double logMiss, int* colIdx, double* values) {
+    long count = 0;
+    long col = -1;
+    for (;;) {
+        // Draw number count of this row decides the gap, so the pattern is independent of the other rows
+        double u = randomUniformOpen(patternKey, (uint64_t)i, (uint64_t)count);
+        // The gap stays a double until it is known to land inside the row: at tiny densities it can
+        // exceed the range of long (or be infinite)
+        double gap = floor(log(u) / logMiss);
+        if (gap >= (double)(cols - col - 1)) {
+            return count;
+        }
+        col += 1 + (long)gap;
+        if (colIdx != NULL) {
+            colIdx[count] = (int)col;
+            values[count] = randomUniform(key, (uint64_t)i, (uint64_t)col);
+        }
+        count++;
+    }
+}
+
+// Function to create rows [rowBegin, rowEnd) of a random CSR matrix where each entry is nonzero with
+// probability density; row i of the result is row rowBegin + i of the whole matrix. Rows are counted
+// first and then filled, both in parallel with OpenMP; a nonzero (i, j) has the same value createMatrix
+// would give element (i, j), and the pattern comes from its own stream, so any row split of the matrix
+// gives the same rows.
+static inline CsrMatrix createRandomCsrRows(int rowBegin, int rowEnd, int cols, double density, uint64_t seed) {
+    uint64_t key = randomKey(seed, RANDOM_STREAM_MATRIX);
+    uint64_t patternKey = randomKey(seed, RANDOM_STREAM_PATTERN);
+    double logMiss = log1p(-density); // -inf when density == 1, which makes every gap zero
+    int rows = rowEnd - rowBegin;
+    CsrMatrix csr = {rows, cols, 0, (long*)malloc((rows + 1) * sizeof(long)), NULL, NULL};
+    if (csr.rowPtr == NULL) {
+        return csr;
+    }
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic, 64)
+#endif
+    for (int i = 0; i < rows; i++) {
+        csr.rowPtr[i + 1] = randomCsrRow(key, patternKey, rowBegin + i, cols, logMiss, NULL, NULL);
+    }
+    csr.rowPtr[0] = 0;
+    for (int i = 0; i < rows; i++) {
+        csr.rowPtr[i + 1] += csr.rowPtr[i];
+    }
+    csr.nnz = csr.rowPtr[rows];
+    csr.colIdx = (int*)malloc((csr.nnz > 0 ? csr.nnz : 1) * sizeof(int));
+    csr.values = allocAligned(csr.nnz);
+    if (csr.colIdx == NULL || csr.values == NULL) {
+        freeCsr(&csr);
+        return csr;
+    }
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic, 64)
+#endif
+    for (int i = 0; i < rows; i++) {
+        randomCsrRow(key, patternKey, rowBegin + i, cols, logMiss, csr.colIdx + csr.rowPtr[i], csr.values + csr.rowPtr[i]);
+    }
+    return csr;
+}
+
+// Function to create a random CSR matrix where each entry is nonzero with probability density
+static inline CsrMatrix createRandomCsr(int rows, int cols, double density, uint64_t seed) {
+    return createRandomCsrRows(0, rows, cols, density, seed);
+}
+
+// Length and original index of a row, used to sort rows inside a sigma window
+typedef struct {
+    long length;
+    int row;
+} SellRowKey;
+
+static inline int compareSellRowKeys(const void* a, const void* b) {
+    const SellRowKey* x = (const SellRowKey*)a;
+    const SellRowKey* y = (const SellRowKey*)b;
+    if (x->length != y->length) {
+        return x->length > y->length ? -1 : 1; // Longest rows first
+    }
+    return x->row - y->row;
+}
+
+// Function to release the storage of a SELL-C-sigma matrix
+static inline void freeSell(SellMatrix* sell) {
+    free(sell->chunkPtr);
+    free(sell->chunkWidth);
+    free(sell->rowPerm);
+    free(sell->colIdx);
+    free(sell->values);
+    sell->chunkPtr = NULL;
+    sell->chunkWidth = NULL;
+    sell->rowPerm = NULL;
+    sell->colIdx = NULL;
+    sell->values = NULL;
+}
+
+// Function to convert CSR into SELL-C-sigma; padding entries hold column 0 and value 0.
+// The arrays are NULL if an allocation failed.
+static inline SellMatrix sellFromCsr(const CsrMatrix* csr, int sigma) {
+    const int C = SELL_CHUNK_HEIGHT;
+    SellMatrix sell;
+    memset(&sell, 0, sizeof(sell));
+    sell.rows = csr->rows;
+    sell.cols = csr->cols;
+    sell.sigma = sigma < C ? C : sigma / C * C;
+    sell.numChunks = (csr->rows + C - 1) / C;
+
+    int slots = sell.numChunks * C;
+    SellRowKey* keys = (SellRowKey*)malloc((slots > 0 ? slots : 1) * sizeof(SellRowKey));
+    sell.chunkPtr = (long*)malloc((sell.numChunks + 1) * sizeof(long));
+    sell.chunkWidth = (int*)malloc((sell.numChunks > 0 ? sell.numChunks : 1) * sizeof(int));
+    sell.rowPerm = (int*)malloc((slots > 0 ? slots : 1) * sizeof(int));
+    if (keys == NULL || sell.chunkPtr == NULL || sell.chunkWidth == NULL || sell.rowPerm == NULL) {
+        free(keys);
+        freeSell(&sell);
+        return sell;
+    }
+
+    // Sort the rows by length within each sigma window
+    for (int i = 0; i < csr->rows; i++) {
+        keys[i].length = csr->rowPtr[i + 1] - csr->rowPtr[i];
+        keys[i].row = i;
+    }
+    for (int begin = 0; begin < csr->rows; begin += sell.sigma) {
+        int count = csr->rows - begin < sell.sigma ? csr->rows - begin : sell.sigma;
+        qsort(keys + begin, count, sizeof(SellRowKey), compareSellRowKeys);
+    }
+    for (int slot = 0; slot < slots; slot++) {
+        sell.rowPerm[slot] = slot < csr->rows ? keys[slot].row : -1;
+    }
+
+    // Chunk widths and offsets
+    sell.chunkPtr[0] = 0;
+    for (int c = 0; c < sell.numChunks; c++) {
+        long width = 0;
+        for (int r = 0; r < C && c * C + r < csr->rows; r++) {
+            width = keys[c * C + r].length > width ? keys[c * C + r].length : width;
+        }
+        sell.chunkWidth[c] = (int)width;
+        sell.chunkPtr[c + 1] = sell.chunkPtr[c] + width * C;
+    }
+    free(keys);
+
+    long total = sell.chunkPtr[sell.numChunks];
+    sell.colIdx = (int*)calloc(total > 0 ? total : 1, sizeof(int));
+    sell.values = allocAligned(total);
+    if (sell.colIdx == NULL || sell.values == NULL) {
+        freeSell(&sell);
+        return sell;
+    }
+    memset(sell.values, 0, total * sizeof(double));
+
+    // Copy every row into its slot, column by column
+    for (int c = 0; c < sell.numChunks; c++) {
+        for (int r = 0; r < C; r++) {
+            int row = sell.rowPerm[c * C + r];
+            if (row < 0) {
+                continue;
+            }
+            long src = csr->rowPtr[row];
+            long length = csr->rowPtr[row + 1] - src;
+            for (long k = 0; k < length; k++) {
+                sell.colIdx[sell.chunkPtr[c] + k * C + r] = csr->colIdx[src + k];
+                sell.values[sell.chunkPtr[c] + k * C + r] = csr->values[src + k];
+            }
+        }
+    }
+    return sell;
+}
+
+// Function to release a sparse matrix in either format
+static inline void freeSparse(SparseMatrix* sparse) {
+    freeCsr(&sparse->csr);
+    if (sparse->format == SPARSE_SELL) {
+        freeSell(&sparse->sell);
+    }
+}
+
+// Function to compute rows [rowBegin, rowEnd) of result = csr * vector
+static inline void spmvCsr(const CsrMatrix* csr, const double* vector, double* result, int rowBegin, int rowEnd) {
+    for (int i = rowBegin; i < rowEnd; i++) {
+        double s0 = 0.0, s1 = 0.0;
+        long k = csr->rowPtr[i];
+        long end = csr->rowPtr[i + 1];
+        for (; k + 2 <= end; k += 2) {
+            s0 += csr->values[k] * vector[csr->colIdx[k]];
+            s1 += csr->values[k + 1] * vector[csr->colIdx[k + 1]];
+        }
+        if (k < end) {
+            s0 += csr->values[k] * vector[csr->colIdx[k]];
+        }
+        result[i] = s0 + s1;
+    }
+}
+
+// A SELL kernel computes the rows stored in chunks [chunkBegin, chunkEnd)
+typedef void (*SellKernel)(const SellMatrix* sell, const double* vector, double* result, int chunkBegin, int chunkEnd);
+
+static void spmvSellScalar(const SellMatrix* sell, const double* vector, double* result, int chunkBegin, int chunkEnd) {
+    const int C = SELL_CHUNK_HEIGHT;
+    for (int c = chunkBegin; c < chunkEnd; c++) {
+        double acc[SELL_CHUNK_HEIGHT] = {0.0};
+        const int* colIdx = sell->colIdx + sell->chunkPtr[c];
+        const double* values = sell->values + sell->chunkPtr[c];
+        for (int k = 0; k < sell->chunkWidth[c]; k++) {
+            for (int r = 0; r < C; r++) {
+                acc[r] += values[k * C + r] * vector[colIdx[k * C + r]];
+            }
+        }
+        for (int r = 0; r < C; r++) {
+            int row = sell->rowPerm[c * C + r];
+            if (row >= 0) {
+                result[row] = acc[r];
+            }
+        }
+    }
+}
+
+#ifdef MXV_X86
+
+// AVX2 SELL kernel: each chunk is two registers of 4 rows, with gathered vector entries
+__attribute__((target("avx2,fma")))
+static void spmvSellAvx2(const SellMatrix* sell, const double* vector, double* result, int chunkBegin, int chunkEnd) {
+    const int C = SELL_CHUNK_HEIGHT;
+    for (int c = chunkBegin; c < chunkEnd; c++) {
+        __m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd();
+        const int* colIdx = sell->colIdx + sell->chunkPtr[c];
+        const double* values = sell->values + sell->chunkPtr[c];
+        for (int k = 0; k < sell->chunkWidth[c]; k++) {
+            __m128i idx0 = _mm_loadu_si128((const __m128i*)(colIdx + k * C));
+            __m128i idx1 = _mm_loadu_si128((const __m128i*)(colIdx + k * C + 4));
+            acc0 = _mm256_fmadd_pd(_mm256_load_pd(values + k * C), _mm256_i32gather_pd(vector, idx0, 8), acc0);
+            acc1 = _mm256_fmadd_pd(_mm256_load_pd(values + k * C + 4), _mm256_i32gather_pd(vector, idx1, 8), acc1);
+        }
+        double acc[SELL_CHUNK_HEIGHT];
+        _mm256_storeu_pd(acc, acc0);
+        _mm256_storeu_pd(acc + 4, acc1);
+        for (int r = 0; r < C; r++) {
+            int row = sell->rowPerm[c * C + r];
+            if (row >= 0) {
+                result[row] = acc[r];
+            }
+        }
+    }
+}
+
+// AVX-512 SELL kernel: one register per chunk, with gathered vector entries
+__attribute__((target("avx512f")))
+static void spmvSellAvx512(const SellMatrix* sell, const double* vector, double* result, int chunkBegin, int chunkEnd) {
+    const int C = SELL_CHUNK_HEIGHT;
+    for (int c = chunkBegin; c < chunkEnd; c++) {
+        __m512d acc = _mm512_setzero_pd();
+        const int* colIdx = sell->colIdx + sell->chunkPtr[c];
+        const double* values = sell->values + sell->chunkPtr[c];
+        for (int k = 0; k < sell->chunkWidth[c]; k++) {
+            __m256i idx = _mm256_loadu_si256((const __m256i*)(colIdx + k * C));
+            acc = _mm512_fmadd_pd(_mm512_load_pd(values + k * C), _mm512_i32gather_pd(idx, vector, 8), acc);
+        }
+        double out[SELL_CHUNK_HEIGHT];
+        _mm512_storeu_pd(out, acc);
+        for (int r = 0; r < C; r++) {
+            int row = sell->rowPerm[c * C + r];
+            if (row >= 0) {
+                result[row] = out[r];
+            }
+        }
+    }
+}
+
+#endif // MXV_X86
+
+// Function to pick the SELL kernel matching the dense kernel chosen in mXv_simd.h
+static inline SellKernel selectSellKernel(void) {
+#ifdef MXV_X86
+    const char* level = selectGemvKernelInfo()->name;
+    if (strcmp(level, "avx512") == 0) {
+        return spmvSellAvx512;
+    }
+    if (strcmp(level, "avx2") == 0) {
+        return spmvSellAvx2;
+    }
+#endif
+    return spmvSellScalar;
+}
+
+// Function to build the sparse matrix in the requested format from a CSR matrix (which it takes over).
+// Returns -1 if the SELL conversion ran out of memory.
+static inline int makeSparse(SparseMatrix* sparse, CsrMatrix csr, SparseFormat format, int sigma) {
+    sparse->format = format;
+    sparse->csr = csr;
+    if (format == SPARSE_SELL) {
+        sparse->sell = sellFromCsr(&csr, sigma);
+        if (sparse->sell.values == NULL) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Function to create rows [rowBegin, rowEnd) of a random sparse matrix: directly in CSR when density > 0,
+// otherwise by converting those rows of the dense random matrix from createMatrix. Returns -1 if memory
+// ran out.
+static inline int createSparseRows(SparseMatrix* sparse, int rowBegin, int rowEnd, int cols, SparseFormat format,
+                                   double density, int sigma, uint64_t seed) {
+    CsrMatrix csr;
+    if (density > 0.0) {
+        csr = createRandomCsrRows(rowBegin, rowEnd, cols, density, seed);
+    } else {
+        Matrix dense = allocMatrix(rowEnd - rowBegin, cols);
+        if (dense.data == NULL) {
+            return -1;
+        }
+        uint64_t key = randomKey(seed, RANDOM_STREAM_MATRIX);
+#ifdef _OPENMP
+        #pragma omp parallel
+        {
+            int begin, end;
+            rowBand(dense.rows, omp_get_num_threads(), omp_get_thread_num(), &begin, &end);
+            fillMatrixRows(&dense, key, begin, end, rowBegin);
+        }
+#else
+        fillMatrixRows(&dense, key, 0, dense.rows, rowBegin);
+#endif
+        csr = csrFromDense(&dense);
+        freeMatrix(&dense);
+    }
+    if (csr.values == NULL) {
+        return -1;
+    }
+    if (makeSparse(sparse, csr, format, sigma) != 0) {
+        freeCsr(&sparse->csr);
+        return -1;
+    }
+    return 0;
+}
+
+// Function to create a random sparse matrix of rows x cols, see createSparseRows
+static inline int createSparse(SparseMatrix* sparse, int rows, int cols, SparseFormat format, double density, int sigma,
+                               uint64_t seed) {
+    return createSparseRows(sparse, 0, rows, cols, format, density, sigma, seed);
+}
+
+// Function for sequential sparse matrix-vector multiplication
+static inline void sparseMatrixVectorMultiply(const SparseMatrix* sparse, const double* vector, double* result) {
+    if (sparse->format == SPARSE_SELL) {
+        selectSellKernel()(&sparse->sell, vector, result, 0, sparse->sell.numChunks);
+    } else {
+        spmvCsr(&sparse->csr, vector, result, 0, sparse->csr.rows);
+    }
+}
+
+// Function to find the first row of band part when the rows are split into parts bands of about equal nonzeros
+static inline int csrNnzBandStart(const CsrMatrix* csr, int parts, int part) {
+    long target = (long)((double)csr->nnz * part / parts);
+    int lo = 0, hi = csr->rows;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (csr->rowPtr[mid] < target) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return part == parts ? csr->rows : lo;
+}
+
+#ifdef _OPENMP
+
+// Function for sparse matrix-vector multiplication using OpenMP. CSR rows are split into bands
+// of equal nonzero count; SELL chunks are handed out dynamically since their widths differ.
+static inline void sparseMatrixVectorMultiplyOpenMP(const SparseMatrix* sparse, const double* vector, double* result) {
+    if (sparse->format == SPARSE_SELL) {
+        SellKernel kernel = selectSellKernel();
+        int numChunks = sparse->sell.numChunks;
+        #pragma omp parallel for schedule(dynamic, 16)
+        for (int c = 0; c < numChunks; c++) {
+            kernel(&sparse->sell, vector, result, c, c + 1);
+        }
+    } else {
+        #pragma omp parallel
+        {
+            int parts = omp_get_num_threads();
+            int part = omp_get_thread_num();
+            int rowBegin = csrNnzBandStart(&sparse->csr, parts, part);
+            int rowEnd = csrNnzBandStart(&sparse->csr, parts, part + 1);
+            spmvCsr(&sparse->csr, vector, result, rowBegin, rowEnd);
+        }
+    }
+}
+
+#endif // _OPENMP
+
+#endif // MXV_SPARSE_H
@@ -7,41 +7,31 @@
 #include <stdlib.h>
 #include <time.h>
 #include <omp.h>
-
-// Function to dynamically allocate a matrix and fill it with random values
-double** createMatrix(int rows, int cols) {
-    double** matrix = (double**)malloc(rows * sizeof(double*));
-    for (int i = 0; i < rows; i++) {
-        matrix[i] = (double*)malloc(cols * sizeof(double));
-        for (int j = 0; j < cols; j++) {
-            matrix[i][j] = rand() / (double)RAND_MAX;
-        }
-    }
-    return matrix;
+#include "mXv_matrix.h"
+#include "mXv_simd.h"
+#include "mXv_options.h"
+#include "mXv_sparse.h"
+#include "mXv_lowp.h"
+#include "mXv_output.h"
+#include "mXv_plan.h"
+
+// Function for multiplying the matrix by a block of vectors (one per column of vectors) in one pass
+void matrixMultiVectorMultiply(const Matrix* matrix, const Matrix* vectors, Matrix* results) {
+    GemvBatchKernel kernel = selectGemvBatchKernel();
+    kernel(matrix, vectors, results, 0, matrix->rows);
 }
 
-// Function to dynamically allocate a vector and fill it with random values
-double* createVector(int size) {
-    double* vector = (double*)malloc(size * sizeof(double));
-    for (int i = 0; i < size; i++) {
-        vector[i] = rand() / (double)RAND_MAX;
-    }
-    return vector;
+// Function for matrix-vector multiplication with a reduced precision matrix
+void matrixVectorMultiplyLowp(const LowpMatrix* matrix, const double* vector, double* result) {
+    LowpKernel kernel = selectLowpKernel();
+    kernel(matrix, vector, result, 0, matrix->rows);
 }
 
-// Function for matrix-vector multiplication
-void matrixVectorMultiply(double** matrix, double* vector, double* result, int rows, int cols) {
-    for (int i = 0; i < rows; i++) {
-        result[i] = 0.0;
-        for (int j = 0; j < cols; j++) {
-            result[i] += matrix[i][j] * vector[j];
-        }
-    }
-}
 
 int main(int argc, char* argv[]) {
-    if (argc != 3) {
-        printf("Usage: %s <matrix_rows> <matrix_cols/vector_size>\n", argv[0]);
+    Options options;
+    if (argc < 3 || parseOptions(argc, argv, 3, &options) != 0) {
+        printf("Usage: %s <matrix_rows> <matrix_cols/vector_size> [--vectors=<k>] [--sparse=csr|sell] [--density=<d>] [--sigma=<rows>] [--precision=f64|f32|bf16|i8] [--seed=<n>] [--repeat=<n>] [--output=none|checksum|binary|text] [--output-file=<path>]\n", argv[0]);
         return 1;
     }
 
@@ -54,55 +44,129 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
-    // Seed the random number generator
-    srand(time(NULL));
+    if (checkEngineOptions(&options) != 0) {
+        return 1;
+    }
+
+    // Keys of the counter-based random streams; the same --seed gives the same data in every program
+    uint64_t matrixKey = randomKey(options.seed, RANDOM_STREAM_MATRIX);
+    uint64_t vectorKey = randomKey(options.seed, RANDOM_STREAM_VECTOR);
+
+    if (options.sparse != SPARSE_NONE) {
+        // Sparse mode: the matrix is stored as CSR or SELL-C-sigma and only its nonzeros are touched
+        SparseMatrix sparse;
+        double* vector = createVector(matrixCols, vectorKey);
+        double* result = allocAligned(matrixRows);
+        if (vector == NULL || result == NULL ||
+            createSparse(&sparse, matrixRows, matrixCols, options.sparse, options.density, options.sigma, options.seed) != 0) {
+            fprintf(stderr, "Memory allocation failed for sparse matrix or vectors.\n");
+            return 1;
+        }
+
+        // Perform the sparse matrix-vector multiplication
+        sparseMatrixVectorMultiply(&sparse, vector, result);
+
+        if (options.output == OUTPUT_TEXT) {
+            printf("Sparse matrix with %ld nonzeros\n", sparse.csr.nnz);
+        }
+        int status = outputResult(&options, result, matrixRows, 1, 1);
+
+        freeSparse(&sparse);
+        free(vector);
+        free(result);
+        return status == 0 ? 0 : 1;
+    }
+
+    if (options.precision != PRECISION_F64) {
+        // Reduced precision mode: the matrix is stored in fewer bytes per element and widened on the fly
+        LowpMatrix lowp = createLowpMatrix(matrixRows, matrixCols, options.precision, matrixKey);
+        double* vector = createVector(matrixCols, vectorKey);
+        double* result = allocAligned(matrixRows);
+        if (lowp.data == NULL || vector == NULL || result == NULL) {
+            fprintf(stderr, "Memory allocation failed for matrix or vectors.\n");
+            return 1;
+        }
+
+        // Perform the matrix-vector multiplication
+        matrixVectorMultiplyLowp(&lowp, vector, result);
+
+        int status = outputResult(&options, result, matrixRows, 1, 1);
+
+        freeLowpMatrix(&lowp);
+        free(vector);
+        free(result);
+        return status == 0 ? 0 : 1;
+    }
 
     // Create and fill the matrix and vector with random values
-    double** matrix = createMatrix(matrixRows, matrixCols);
-    double* vector = createVector(matrixCols); // The vector size is the same as the number of columns in the matrix
-    double* result = (double*)malloc(matrixRows * sizeof(double)); // The result vector size is the same as the number of rows in the matrix
+    Matrix matrix = createMatrix(matrixRows, matrixCols, matrixKey);
+
+    if (options.vectors > 1) {
+        // Multi-vector mode: the matrix is multiplied by a block of vectors in a single pass over it
+        Matrix vectors = createMatrix(matrixCols, options.vectors, vectorKey); // One vector per column
+        Matrix results = allocMatrix(matrixRows, options.vectors);
+        if (matrix.data == NULL || vectors.data == NULL || results.data == NULL) {
+            fprintf(stderr, "Memory allocation failed for matrix or vectors.\n");
+            return 1;
+        }
+        // Perform the multiplication for all vectors at once
+        matrixMultiVectorMultiply(&matrix, &vectors, &results);
+        if (options.output == OUTPUT_TEXT) {
+            printMatrix("Generated matrix", &matrix);
+            printMatrix("Generated vectors (one per column)", &vectors);
+        }
+        int status = outputResult(&options, results.data, results.rows, results.cols, results.ld);
+
+        freeMatrix(&matrix);
+        freeMatrix(&vectors);
+        freeMatrix(&results);
+        return status == 0 ? 0 : 1;
+    }
+
+    double* vector = createVector(matrixCols, vectorKey); // The vector size is the same as the number of columns in the matrix
+    double* result = allocAligned(matrixRows); // The result vector size is the same as the number of rows in the matrix
+    if (matrix.data == NULL || vector == NULL || result == NULL) {
+        fprintf(stderr, "Memory allocation failed for matrix or vectors.\n");
+        return 1;
+    }
 
     // Initialize result vector to zero
     for (int i = 0; i < matrixRows; i++) {
         result[i] = 0.0;
     }
     
-    // Print the generated matrix
-    printf("Generated matrix:\n");
-    for (int i = 0; i < matrixRows; i++) {
-        for (int j = 0; j < matrixCols; j++) {
-            printf("%f ", matrix[i][j]);
+    // Print the generated matrix and vector when the text output is asked for
+    if (options.output == OUTPUT_TEXT) {
+        printMatrix("Generated matrix", &matrix);
+        printf("Generated vector:\n");
+        for (int i = 0; i < matrixCols; i++) {
+            printf("%f ", vector[i]);
         }
-        printf("\n");
+        printf("\n\n");
     }
 
-    printf("\n");
-
-    // Print the generated vector
-    printf("Generated vector:\n");
-    for (int i = 0; i < matrixCols; i++) {
-        printf("%f ", vector[i]);
-    }
-    printf("\n\n");
-
 
 
-    // Perform the matrix-vector multiplication
-    matrixVectorMultiply(matrix, vector, result, matrixRows, matrixCols);
-
-    printf("Resulting vector:\n");
-    for (int i = 0; i < matrixRows; i++) {
-        printf("%f\n", result[i]);
+    // Plan the multiplication once (the widest SIMD kernel the CPU supports), then execute it --repeat times on the same matrix
+    MatvecPlan plan;
+    if (createMatvecPlan(&plan, ENGINE_SEQUENTIAL, matrixRows, matrixCols, 1, 0) != 0) {
+        fprintf(stderr, "Memory allocation failed for the execution plan.\n");
+        return 1;
+    }
+    double start = omp_get_wtime();
+    for (int r = 0; r < options.repeat; r++) {
+        executeMatvecPlan(&plan, &matrix, vector, result);
     }
+    printRepeatTiming(options.repeat, omp_get_wtime() - start, matrixRows, matrixCols);
+    destroyMatvecPlan(&plan);
+
+    int status = outputResult(&options, result, matrixRows, 1, 1);
 
     // Cleanup
-    for (int i = 0; i < matrixRows; i++) {
-        free(matrix[i]);
-    }
-    free(matrix);
+    freeMatrix(&matrix);
     free(vector);
     free(result);
 
-    return 0;
+    return status == 0 ? 0 : 1;
 }
 
@@ -1,70 +1,125 @@
 /*
  * Programmer(s) : Syed Saad Ullah Hussaini, K214703 Ali Raza, K213100 Muhammad Sameed
  * Date: 12 March 2024
- * Desc: MPI Tiled version of matrix vector multiplication. 
+ * Desc: MPI Tiled version of matrix vector multiplication. The ranks form a 2D
+ *       process grid and each one multiplies a block of the matrix tile by tile.
  */
 
+#define _GNU_SOURCE // sched_setaffinity and sched_getcpu, used by mXv_numa.h through mXv_mpi.h
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
 #include <assert.h>
 #include <mpi.h>
+#include "mXv_matrix.h"
+#include "mXv_simd.h"
+#include "mXv_options.h"
+#include "mXv_lowp.h"
+#include "mXv_output.h"
+#include "mXv_mpi.h"
 
-// Function to dynamically allocate a matrix and fill it with random values
-double *createMatrix(int rows, int cols, int seed)
-{
-    srand(seed); // Seed the random number generator
-    double *matrix = (double *)malloc(rows * cols * sizeof(double));
-    if (matrix == NULL) {
-        // Handle memory allocation failure
-        fprintf(stderr, "Memory allocation failed for matrix.\n");
-        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+// Reduced precision mode: root generates the matrix directly in the narrow format and scatters the
+// row slabs as raw bytes, so 2-8x fewer bytes cross the network than with doubles
+int runLowPrecision(int rank, int size, int matrixRows, int matrixCols, int tileSize, int threads, const Options *options) {
+    int rowBegin, rowEnd;
+    rowBand(matrixRows, size, rank, &rowBegin, &rowEnd);
+    int localRows = rowEnd - rowBegin;
+    int *rowCounts = malloc(size * sizeof(int));
+    int *rowDispls = malloc(size * sizeof(int));
+    rowCountsAndDispls(matrixRows, size, rowCounts, rowDispls);
+
+    LowpMatrix localTiles = allocLowpMatrix(localRows, matrixCols, options->precision);
+    double* localResults = allocAligned(localRows);
+    double* partial = allocAligned(2 * (size_t)localRows);
+    double* vector = NULL;
+
+    // Root process creates the vector, and the full matrix when it is scattered
+    LowpMatrix matrix = {options->precision, 0, 0, 0, NULL, NULL};
+    if (rank == 0) {
+        if (options->distribution != DISTRIBUTION_LOCAL) {
+            matrix = createLowpMatrix(matrixRows, matrixCols, options->precision, randomKey(options->seed, RANDOM_STREAM_MATRIX));
+        }
+        vector = createVector(matrixCols, randomKey(options->seed, RANDOM_STREAM_VECTOR));
+    } else {
+        vector = allocAligned(matrixCols);
     }
-    for (int i = 0; i < rows * cols; i++)
-    {
-        matrix[i] = rand() / (double) RAND_MAX;
+    if (localTiles.data == NULL || localResults == NULL || partial == NULL || vector == NULL ||
+        (rank == 0 && options->distribution != DISTRIBUTION_LOCAL && matrix.data == NULL)) {
+        fprintf(stderr, "Memory allocation failed for matrix or vector.\n");
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
     }
-    return matrix;
-}
 
-// Function to dynamically allocate a vector and fill it with random values
-double *createVector(int size, int seed)
-{
-    srand(seed); // Seed the random number generator
-    double *vector = (double *)malloc(size * sizeof(double));
-    if (vector == NULL) {
-        // Handle memory allocation failure
-        fprintf(stderr, "Memory allocation failed for vector.\n");
-        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    // Every rank generates its own reduced precision row slab, or root scatters them; then broadcast the vector
+    if (options->distribution == DISTRIBUTION_LOCAL) {
+        if (fillLowpRows(&localTiles, randomKey(options->seed, RANDOM_STREAM_MATRIX), 0, localTiles.rows, rowBegin) != 0) {
+            fprintf(stderr, "Memory allocation failed for matrix.\n");
+            MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+        }
+    } else {
+        scatterLowpRows(&matrix, &localTiles, rowCounts, rowDispls, 0, MPI_COMM_WORLD);
     }
-    for (int i = 0; i < size; i++)
+    MPI_Bcast(vector, matrixCols, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+
+    // Perform the local tiled multiplication, widening the elements on the fly; every one of the rank's
+    // threads sweeps its own row band with its own part of the tile buffers
+    LowpKernel kernel = selectLowpKernel();
+    int tileCols = chooseTileColumns(matrixCols, tileSize);
+#ifdef _OPENMP
+    #pragma omp parallel num_threads(threads) if (threads > 1)
     {
-        vector[i] = rand() / (double) RAND_MAX;
+        int begin, end;
+        rowBand(localRows, omp_get_num_threads(), omp_get_thread_num(), &begin, &end);
+        double* band = partial + 2 * (size_t)begin;
+        lowpTiledBand(kernel, &localTiles, vector, localResults, begin, end, tileCols, band, band + (end - begin));
     }
-    return vector;
-}
+#else
+    (void)threads;
+    lowpTiledBand(kernel, &localTiles, vector, localResults, 0, localRows, tileCols, partial, partial + localRows);
+#endif
 
-// Function for tiled matrix-vector multiplication using MPI
-void matrixVectorMultiplyTiledMPI(double* localTiles, double* vector, double* localResults, int numLocalRows, int matrixCols, int tileSize, int rank, int size) {
-    // Perform the multiplication on local tiles
-    for (int i = 0; i < numLocalRows; i++) {
-        for (int j = 0; j < matrixCols; j++) {
-            localResults[i] += localTiles[i * matrixCols + j] * vector[j];
+    // Gather the local results on root and output them, or output them where they are
+    int status = 0;
+    if (options->distributedResult) {
+        status = outputDistributedResult(options, localResults, rowCounts, rowDispls, matrixRows, 0, MPI_COMM_WORLD);
+    } else {
+        double* result = NULL;
+        if (rank == 0) {
+            result = allocAligned(matrixRows);
+        }
+        MPI_Gatherv(localResults, localRows, MPI_DOUBLE, result, rowCounts, rowDispls, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+        if (rank == 0) {
+            status = outputResult(options, result, matrixRows, 1, 1);
+            free(result);
         }
     }
+
+    // Cleanup
+    freeLowpMatrix(&matrix);
+    freeLowpMatrix(&localTiles);
+    free(localResults);
+    free(partial);
+    free(vector);
+    free(rowCounts);
+    free(rowDispls);
+    return status == 0 ? 0 : 1;
 }
 
 
+
 int main(int argc, char* argv[]) {
-    MPI_Init(&argc, &argv);
+    // Only the main thread of a rank calls MPI; the OpenMP threads of the hybrid engine just compute
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
     int rank, size;
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
     MPI_Comm_size(MPI_COMM_WORLD, &size);
 
     // Ensure the correct number of arguments are provided
-    if (argc != 4) {
+    Options options;
+    if (argc < 4 || parseOptions(argc, argv, 4, &options) != 0 || checkEngineOptions(&options) != 0 ||
+        checkInputOptions(&options, rank) != 0 || options.sparse != 0 || options.vectors > 1) {
         if (rank == 0) {
-            fprintf(stderr, "Usage: %s <matrixRows> <matrixCols> <tileSize>\n", argv[0]);
+            fprintf(stderr, "Usage: %s <matrixRows> <matrixCols> <tileSize> [--precision=f64|f32|bf16|i8] [--seed=<n>] [--repeat=<n>] [--power-iterations=<n>] [--distribution=local|scatter|pipelined] [--chunks=<n>] [--threads=<n>] [--affinity=none|compact|scatter] [--result=gather|distributed] [--output=none|checksum|binary|text] [--output-file=<path>] [--input=<path>]\n", argv[0]);
         }
         MPI_Finalize();
         return 1;
@@ -74,80 +129,130 @@ int main(int argc, char* argv[]) {
     int matrixCols = atoi(argv[2]);
     int tileSize = atoi(argv[3]);
 
-    // Check if matrix dimensions are divisible by tile size
-    if (matrixRows % tileSize != 0 || matrixCols % tileSize != 0) {
+    // Column tile width of the local multiplication; 0 picks one from the L2 cache size. Blocks of any
+    // size are handled, the last tile of a block is simply narrower
+    if (matrixRows <= 0 || matrixCols <= 0 || tileSize < 0) {
         if (rank == 0) {
-            fprintf(stderr, "Error: Matrix dimensions must be divisible by tileSize.\n");
+            fprintf(stderr, "Error: Matrix rows and columns must be positive and tileSize must not be negative.\n");
         }
         MPI_Finalize();
         return 1;
     }
 
-    // Calculate the number of rows per process
-    int rowsPerProcess = matrixRows / size;
-    int remainingRows = matrixRows % size;
-    if (rank < remainingRows) {
-        rowsPerProcess++;
-    }
-
-    int *sendCounts = malloc(size * sizeof(int));
-    int *displs = malloc(size * sizeof(int));
-    int sum = 0;
-    for (int i = 0; i < size; i++) {
-        sendCounts[i] = (matrixRows / size) * matrixCols;
-        if (i < remainingRows) {
-            sendCounts[i] += matrixCols;
-        }
-        displs[i] = sum;
-        sum += sendCounts[i];
+    if (checkPowerIterationOptions(&options, matrixRows, matrixCols, rank) != 0 || checkPipelinedOptions(&options, rank) != 0) {
+        MPI_Finalize();
+        return 1;
     }
 
-    // Allocate memory for local tiles and results
-    double* localTiles = (double*)malloc(tileSize * matrixCols * rowsPerProcess * sizeof(double));
-    double* localResults = (double*)calloc(rowsPerProcess, sizeof(double));
-    double* vector = (double*)malloc(matrixCols * sizeof(double));
+    // Hybrid engine: with --threads=n every rank sweeps its block with n OpenMP threads; set up before the
+    // modes run, so the reduced precision mode uses them too
+    int threads = setupRankThreads(&options, provided, rank);
 
-    // Root process creates the full matrix and vector
-    double* matrix = NULL;
-    if (rank == 0) {
-        matrix = createMatrix(matrixRows, matrixCols, time(NULL));
-        vector = createVector(matrixCols, time(NULL) + 1);
+    if (options.precision != PRECISION_F64) {
+        int status = runLowPrecision(rank, size, matrixRows, matrixCols, tileSize, threads, &options);
+        MPI_Finalize();
+        return status;
     }
 
-    // Scatter the tiles of the matrix to all processes
-    MPI_Scatter(matrix, tileSize * matrixCols * rowsPerProcess, MPI_DOUBLE, localTiles, tileSize * matrixCols * rowsPerProcess, MPI_DOUBLE, 0, MPI_COMM_WORLD);
-
-    // Broadcast the vector to all processes
-    MPI_Bcast(vector, matrixCols, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    // Plan the multiplication on a 2D process grid once: the grid and its row and column communicators,
+    // the local block of A and the tile buffers of its tiled multiplication are reused by every execution
+    MpiGridPlan plan;
+    if (createMpiGridPlan(&plan, ENGINE_TILED, matrixRows, matrixCols, threads, tileSize, MPI_COMM_WORLD) != 0) {
+        fprintf(stderr, "Memory allocation failed for the execution plan.\n");
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
 
-    // Perform the local tiled multiplication
-    matrixVectorMultiplyTiledMPI(localTiles, vector, localResults, rowsPerProcess, matrixCols, tileSize, rank, size);
+    // Hand the plan its matrix: by default every rank generates only its own block, so no rank ever holds
+    // the whole matrix; with --distribution=scatter root creates it and sends every block once, and with
+    // --distribution=pipelined the blocks are streamed in row chunks during the first execution. A matrix
+    // file (--input) is read by all ranks in parallel, each its own block
+    Matrix matrix = {NULL, 0, 0, 0};
+    if (options.inputFile != NULL) {
+        if (readMpiGridPlan(&plan, options.inputFile) != 0) {
+            destroyMpiGridPlan(&plan);
+            MPI_Finalize();
+            return 1;
+        }
+    } else if (options.distribution == DISTRIBUTION_LOCAL) {
+        generateMpiGridPlan(&plan, randomKey(options.seed, RANDOM_STREAM_MATRIX));
+    } else {
+        if (rank == 0) {
+            matrix = createMatrix(matrixRows, matrixCols, randomKey(options.seed, RANDOM_STREAM_MATRIX));
+            if (matrix.data == NULL) {
+                fprintf(stderr, "Memory allocation failed for matrix.\n");
+                MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+            }
+        }
+        if (options.distribution == DISTRIBUTION_SCATTER) {
+            scatterMpiGridPlan(&plan, &matrix);
+            freeMatrix(&matrix);
+        } else if (createMpiGridPipeline(&plan, options.chunks) != 0) {
+            fprintf(stderr, "Memory allocation failed for the execution plan.\n");
+            MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+        }
+    }
 
-    // Gather the local results into the final result vector
+    // Root process creates the vector, and the result when it is gathered; the other ranks only ever
+    // hold their slice of the vector, inside the plan, except in the power iteration, where every rank
+    // keeps the whole x and there is no separate result
+    int iterate = options.powerIterations > 0;
+    double* vector = NULL;
     double* result = NULL;
     if (rank == 0) {
-        result = (double*)malloc(matrixRows * sizeof(double));
+        vector = createVector(matrixCols, randomKey(options.seed, RANDOM_STREAM_VECTOR));
+        result = options.distributedResult || iterate ? NULL : allocAligned(matrixRows);
+    } else if (iterate) {
+        vector = allocAligned(matrixCols);
+    }
+    if (((rank == 0 || iterate) && vector == NULL) || (rank == 0 && !options.distributedResult && !iterate && result == NULL)) {
+        fprintf(stderr, "Memory allocation failed for vector.\n");
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
     }
-    MPI_Gather(localResults, rowsPerProcess, MPI_DOUBLE, result, rowsPerProcess, MPI_DOUBLE, 0, MPI_COMM_WORLD);
 
-    // Root process prints the result
-    if (rank == 0) {
-        printf("Resulting vector:\n");
-        for (int i = 0; i < matrixRows; i++) {
-            printf("%f\n", result[i]);
+    // Power iteration: x <- A x / ||A x|| with the blocks resident, the output is the last x
+    if (iterate) {
+        double start = MPI_Wtime();
+        double eigenvalue = powerIterationMpiGridPlan(&plan, vector, options.powerIterations);
+        if (rank == 0) {
+            printPowerIteration(options.powerIterations, MPI_Wtime() - start, eigenvalue);
         }
-        free(result);
+        // On root the last x becomes the result that is output (and freed) below
+        result = rank == 0 ? vector : NULL;
+        vector = rank == 0 ? NULL : vector;
     }
 
-    // Cleanup
-    free(localTiles);
-    free(localResults);
-    free(vector);
-    if (rank == 0) {
-        free(matrix);
+    // Every execution sends each rank its slice of the vector, multiplies the local block and reduces
+    // the partial sums along the grid rows; the pieces are gathered on root unless they stay distributed.
+    // A pipelined first execution multiplies the row chunks of the blocks while the next ones arrive
+    double start = MPI_Wtime();
+    for (int r = 0; r < options.repeat && !iterate; r++) {
+        if (options.distribution == DISTRIBUTION_PIPELINED && r == 0) {
+            pipelineMpiGridPlan(&plan, &matrix, vector, result, !options.distributedResult);
+            freeMatrix(&matrix);
+        } else if (options.distributedResult) {
+            computeMpiGridPlan(&plan, vector);
+        } else {
+            executeMpiGridPlan(&plan, vector, result);
+        }
+    }
+    if (rank == 0 && !iterate) {
+        printRepeatTiming(options.repeat, MPI_Wtime() - start, matrixRows, matrixCols);
+    }
+
+    // Output the result
+    int status = 0;
+    if (options.distributedResult) {
+        status = outputDistributedResult(&options, plan.piece, plan.resultCounts, plan.resultDispls, matrixRows, 0,
+                                         MPI_COMM_WORLD);
+    } else if (rank == 0) {
+        status = outputResult(&options, result, matrixRows, 1, 1);
     }
 
+    // Cleanup; on root result is also the last x of a power iteration, whatever the output mode
+    free(result);
+    destroyMpiGridPlan(&plan);
+    free(vector);
+
     MPI_Finalize();
-    return 0;
+    return status == 0 ? 0 : 1;
 }
-
@@ -0,0 +1,31 @@
+#!/bin/bash
+
+# Regression checks of the built programs: run from the directory that holds them, like bashScript.sh
+
+# Initialized the counters of the checks
+failed_count=0
+test_count=0
+
+# Function to run a program and check that it exits with the expected status
+check_exit() {
+    local expected=$1
+    shift
+
+    "$@" > /dev/null 2>&1
+    local status=$?
+    ((test_count++))
+    if [[ "$status" -ne "$expected" ]]; then
+        echo "FAIL (exit $status, expected $expected): $*"
+        ((failed_count++))
+    fi
+}
+
+# Sparse matrices with densities so small the geometric gap overflows a long
+for density in 1e-19 1e-300; do
+    check_exit 0 ./mXv_task02 100 100 --sparse=csr --density=$density --output=checksum
+    check_exit 0 ./mXv_task02 100 100 --sparse=sell --density=$density --output=checksum
+done
+
+# Inform the user of the outcome
+echo "$((test_count - failed_count)) of $test_count checks passed."
+[[ "$failed_count" -eq 0 ]]
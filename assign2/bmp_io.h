@@ -0,0 +1,283 @@
+/*
+ * Programmer(s) : Syed Saad Ullah Hussaini, K214703 Ali Raza, K213100 Muhammad Sameed
+ * Date: 17 October 2026
+ * Desc: BMP input and output of upscale_omp and upscale_mpi. The input file is
+ *       mapped into memory and its pixels are read in place through an
+ *       ImageView, which carries the padded row stride of the file and its row
+ *       order (bottom-up files get a negative stride), so rows are always
+ *       addressed top to bottom and never copied. The output file is created at
+ *       its final size and mapped, and the programs write their rows straight
+ *       into it. Files that cannot be mapped go through one buffer and one large
+ *       read or write instead. releaseBMPRows hands the pages of a finished strip
+ *       back to the kernel, so an image larger than memory can be streamed.
+ */
+
+#ifndef BMP_IO_H
+#define BMP_IO_H
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#pragma pack(push, 1)
+typedef struct {
+    unsigned short type;
+    unsigned int size;
+    unsigned short reserved1, reserved2;
+    unsigned int offset;
+} BMPHeader;
+
+typedef struct {
+    unsigned int size;
+    int width, height;
+    unsigned short planes;
+    unsigned short bitCount;
+    unsigned int compression;
+    unsigned int imageSize;
+    int xPelsPerMeter, yPelsPerMeter;
+    unsigned int clrUsed, clrImportant;
+} BMPInfoHeader;
+#pragma pack(pop)
+
+// Rows of an interleaved 8-bit image in memory: row y starts at data + y * stride
+typedef struct {
+    unsigned char* data;  // Top row
+    ptrdiff_t stride;     // Bytes from a row to the one below it, with the padding; negative for bottom-up rows
+    int width, height, channels;
+} ImageView;
+
+// An open BMP file and the view of its pixels
+typedef struct {
+    BMPHeader header;
+    BMPInfoHeader infoHeader;
+    ImageView view;
+    int fd;
+    int writable;
+    unsigned char* map;     // The whole file if it is mapped, NULL otherwise
+    size_t mapSize;
+    unsigned char* pixels;  // Pixel array, inside map or a buffer of its own
+    size_t pixelBytes;
+} BMPImage;
+
+// Function to get the bytes of a BMP row of width pixels, padded to a multiple of 4
+static inline size_t bmpRowBytes(int width, int bitCount) {
+    return ((size_t)width * bitCount + 31) / 32 * 4;
+}
+
+// Function to get the first byte of row y of a view
+static inline unsigned char* imageRow(const ImageView* view, int y) {
+    return view->data + y * view->stride;
+}
+
+// Function to read or write count bytes at offset, retrying short transfers. Returns 0 on success, -1 on error.
+static inline int transferAt(int fd, void* data, size_t count, off_t offset, int writing) {
+    unsigned char* bytes = (unsigned char*)data;
+    while (count > 0) {
+        ssize_t done = writing ? pwrite(fd, bytes, count, offset) : pread(fd, bytes, count, offset);
+        if (done <= 0) {
+            return -1;
+        }
+        bytes += done;
+        count -= (size_t)done;
+        offset += done;
+    }
+    return 0;
+}
+
+// Function to point the view of an image at its pixel array; the file stores the bottom row first unless
+// the height is negative
+static inline void setBMPView(BMPImage* image) {
+    int height = image->infoHeader.height;
+    ptrdiff_t rowBytes = (ptrdiff_t)bmpRowBytes(image->infoHeader.width, image->infoHeader.bitCount);
+    image->view.width = image->infoHeader.width;
+    image->view.height = height < 0 ? -height : height;
+    image->view.channels = image->infoHeader.bitCount / 8;
+    image->view.stride = height < 0 ? rowBytes : -rowBytes;
+    image->view.data = height < 0 ? image->pixels : image->pixels + (image->view.height - 1) * rowBytes;
+}
+
+// Function to close an image; a mapped output image is synced and a buffered one written out first, so a
+// full disk or an I/O error shows up here. Returns 0 on success, -1 if the pixels could not be written.
+static inline int closeBMP(BMPImage* image) {
+    int status = 0;
+    if (image->map != NULL) {
+        if (image->writable && msync(image->map, image->mapSize, MS_SYNC) != 0) {
+            status = -1;
+        }
+        munmap(image->map, image->mapSize);
+    } else {
+        if (image->writable && image->pixels != NULL) {
+            status = transferAt(image->fd, image->pixels, image->pixelBytes, image->header.offset, 1);
+        }
+        free(image->pixels);
+    }
+    if (image->fd >= 0 && close(image->fd) != 0) {
+        status = -1;
+    }
+    image->fd = -1;
+    image->map = NULL;
+    image->pixels = NULL;
+    return status;
+}
+
+// Function to open an uncompressed 24 or 32-bit BMP for reading. The pixels are mapped, or read into a
+// buffer if the file cannot be mapped. imageSize is not trusted (it is 0 in many files); the size of the
+// pixel array follows from the dimensions. Returns 0 on success, -1 with a message on standard error.
+static inline int openBMP(const char* filename, BMPImage* image) {
+    memset(image, 0, sizeof(*image));
+    image->fd = open(filename, O_RDONLY);
+    struct stat status;
+    if (image->fd < 0 || fstat(image->fd, &status) != 0) {
+        fprintf(stderr, "Cannot open %s\n", filename);
+        closeBMP(image);
+        return -1;
+    }
+    size_t fileSize = (size_t)status.st_size;
+    if (fileSize < sizeof(BMPHeader) + sizeof(BMPInfoHeader) ||
+        transferAt(image->fd, &image->header, sizeof(BMPHeader), 0, 0) != 0 ||
+        transferAt(image->fd, &image->infoHeader, sizeof(BMPInfoHeader), sizeof(BMPHeader), 0) != 0 ||
+        image->header.type != 0x4D42 || image->infoHeader.size < sizeof(BMPInfoHeader)) {
+        fprintf(stderr, "%s is not a BMP file\n", filename);
+        closeBMP(image);
+        return -1;
+    }
+    const BMPInfoHeader* info = &image->infoHeader;
+    if (info->compression != 0 || (info->bitCount != 24 && info->bitCount != 32) || info->width <= 0 ||
+        info->height == 0 || info->height == INT_MIN) {
+        fprintf(stderr, "%s: only uncompressed 24 and 32-bit BMP files are supported\n", filename);
+        closeBMP(image);
+        return -1;
+    }
+    int rows = info->height < 0 ? -info->height : info->height;
+    image->pixelBytes = bmpRowBytes(info->width, info->bitCount) * rows;
+    if (image->header.offset > fileSize || image->pixelBytes > fileSize - image->header.offset) {
+        fprintf(stderr, "%s is truncated\n", filename);
+        closeBMP(image);
+        return -1;
+    }
+
+    void* map = mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE, image->fd, 0);
+    if (map != MAP_FAILED) {
+        image->map = (unsigned char*)map;
+        image->mapSize = fileSize;
+        image->pixels = image->map + image->header.offset;
+        madvise(map, fileSize, MADV_SEQUENTIAL);
+    } else {
+        image->pixels = (unsigned char*)malloc(image->pixelBytes);
+        if (image->pixels == NULL ||
+            transferAt(image->fd, image->pixels, image->pixelBytes, image->header.offset, 0) != 0) {
+            fprintf(stderr, "Cannot read the pixels of %s\n", filename);
+            closeBMP(image);
+            return -1;
+        }
+    }
+    setBMPView(image);
+    return 0;
+}
+
+// Function to create a width x height BMP for writing, with the pixel format, row order and resolution of
+// like. The file is created at its final size and mapped, or buffered until closeBMP if it cannot be
+// mapped; either way its pixels start out zero. Returns 0 on success, -1 with a message on standard error.
+static inline int createBMP(const char* filename, int width, int height, const BMPImage* like, BMPImage* image) {
+    memset(image, 0, sizeof(*image));
+    image->writable = 1;
+    BMPInfoHeader* info = &image->infoHeader;
+    info->size = sizeof(BMPInfoHeader);
+    info->width = width;
+    info->height = like->infoHeader.height < 0 ? -height : height;
+    info->planes = 1;
+    info->bitCount = like->infoHeader.bitCount;
+    info->xPelsPerMeter = like->infoHeader.xPelsPerMeter;
+    info->yPelsPerMeter = like->infoHeader.yPelsPerMeter;
+    image->pixelBytes = bmpRowBytes(width, info->bitCount) * height;
+    image->header.type = 0x4D42;
+    image->header.offset = sizeof(BMPHeader) + sizeof(BMPInfoHeader);
+    // Sizes beyond 4 GiB do not fit the header fields; readers then go by the dimensions, as openBMP does
+    size_t fileSize = image->header.offset + image->pixelBytes;
+    image->header.size = fileSize <= UINT_MAX ? (unsigned int)fileSize : 0;
+    info->imageSize = image->pixelBytes <= UINT_MAX ? (unsigned int)image->pixelBytes : 0;
+
+    image->fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (image->fd < 0 || ftruncate(image->fd, (off_t)fileSize) != 0) {
+        fprintf(stderr, "Cannot create %s\n", filename);
+        closeBMP(image);
+        return -1;
+    }
+    void* map = mmap(NULL, fileSize, PROT_READ | PROT_WRITE, MAP_SHARED, image->fd, 0);
+    if (map != MAP_FAILED) {
+        image->map = (unsigned char*)map;
+        image->mapSize = fileSize;
+        image->pixels = image->map + image->header.offset;
+        memcpy(image->map, &image->header, sizeof(BMPHeader));
+        memcpy(image->map + sizeof(BMPHeader), info, sizeof(BMPInfoHeader));
+    } else {
+        image->pixels = (unsigned char*)calloc(image->pixelBytes, 1);
+        if (image->pixels == NULL || transferAt(image->fd, &image->header, sizeof(BMPHeader), 0, 1) != 0 ||
+            transferAt(image->fd, info, sizeof(BMPInfoHeader), sizeof(BMPHeader), 1) != 0) {
+            fprintf(stderr, "Cannot write %s\n", filename);
+            closeBMP(image);
+            return -1;
+        }
+    }
+    setBMPView(image);
+    return 0;
+}
+
+// Function to get the page-aligned byte range [*begin, *end) of the mapping holding rows [rowBegin, rowEnd),
+// rounded outwards, or inwards so it does not reach into the pages of neighbouring rows
+static inline void bmpRowPages(const BMPImage* image, int rowBegin, int rowEnd, int inwards, size_t* begin, size_t* end) {
+    const unsigned char* first = imageRow(&image->view, rowBegin);
+    const unsigned char* last = imageRow(&image->view, rowEnd - 1);
+    size_t rowBytes = bmpRowBytes(image->view.width, image->infoHeader.bitCount);
+    size_t low = (size_t)((first < last ? first : last) - image->map);
+    size_t high = (size_t)((first < last ? last : first) - image->map) + rowBytes;
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    *begin = (inwards ? low + page - 1 : low) / page * page;
+    *end = (inwards ? high : high + page - 1) / page * page;
+    if (*end > image->mapSize) {
+        *end = image->mapSize;
+    }
+}
+
+// Function to fault in the pages of rows [rowBegin, rowEnd) before a strip works on them: faulting a whole
+// strip in one call is much cheaper than one page fault per page. Read rows are read ahead instead.
+static inline void prepareBMPRows(BMPImage* image, int rowBegin, int rowEnd) {
+    size_t begin, end;
+    if (image->map == NULL || rowEnd <= rowBegin) {
+        return;
+    }
+    bmpRowPages(image, rowBegin, rowEnd, 0, &begin, &end);
+#ifdef MADV_POPULATE_WRITE
+    if (image->writable) {
+        madvise(image->map + begin, end - begin, MADV_POPULATE_WRITE);
+        return;
+    }
+#endif
+    madvise(image->map + begin, end - begin, MADV_WILLNEED);
+}
+
+// Function to give the pages of rows [rowBegin, rowEnd) back once a strip is done with them: written rows
+// are queued for writeback and then unmapped, read rows are unmapped and fault in again if touched later.
+// Only pages entirely inside the rows are released. Buffered images are left alone.
+static inline void releaseBMPRows(BMPImage* image, int rowBegin, int rowEnd) {
+    size_t begin, end;
+    if (image->map == NULL || rowEnd <= rowBegin) {
+        return;
+    }
+    bmpRowPages(image, rowBegin, rowEnd, 1, &begin, &end);
+    if (end <= begin) {
+        return;
+    }
+    if (image->writable) {
+        msync(image->map + begin, end - begin, MS_ASYNC);
+    }
+    madvise(image->map + begin, end - begin, MADV_DONTNEED);
+}
+
+#endif // BMP_IO_H
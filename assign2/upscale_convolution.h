@@ -0,0 +1,612 @@
+/*
+ * Programmer(s) : Syed Saad Ullah Hussaini, K214703 Ali Raza, K213100 Muhammad Sameed
+ * Date: 17 October 2026
+ * Desc: Convolution of 8-bit images with integer N x N kernels (N odd, up to
+ *       MAX_KERNEL_SIZE), each channel on its own, for interleaved and planar
+ *       images. In a row of an interleaved image the same channel of the next
+ *       pixel is `channels` bytes further, so one output row is a sum of byte
+ *       rows shifted by multiples of that step and the kernels below never look
+ *       at channels; a planar image is a stack of one-channel images.
+ *       Kernels that are the outer product of a column and a row are detected
+ *       and run as a horizontal and a vertical 1D pass. The sums are taken with
+ *       scalar, SSE4.1 or AVX2 code picked at runtime from CPUID, in 16-bit
+ *       lanes when no sum can overflow them and in 32-bit lanes otherwise, and
+ *       the threads split the image into bands of rows.
+ *       UPSCALE_SIMD=avx2|sse41 forces a kernel as in upscale_simd.h; scalar and
+ *       double run the portable one.
+ */
+
+#ifndef UPSCALE_CONVOLUTION_H
+#define UPSCALE_CONVOLUTION_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CONVOLUTION_X86 1
+#endif
+
+#define MAX_KERNEL_SIZE 15
+
+typedef enum {
+    LAYOUT_INTERLEAVED = 0, // Rows of width pixels of channels bytes each
+    LAYOUT_PLANAR = 1       // One width x height plane per channel, one after the other
+} ImageLayout;
+
+typedef struct {
+    int size;      // Odd width and height of the kernel
+    int radius;    // size / 2; a border of radius pixels has no full neighbourhood and is left untouched
+    int divisor;   // The sums are divided by it, truncating like C division, and saturated to 0..255
+    int weights[MAX_KERNEL_SIZE * MAX_KERNEL_SIZE];
+    int separable; // weights[y * size + x] == column[y] * row[x]
+    int column[MAX_KERNEL_SIZE];
+    int row[MAX_KERNEL_SIZE];
+    int narrow;    // The sums over bytes (the whole kernel, or the row pass if separable) fit 16 bits
+} ConvolutionKernel;
+
+// Function to get the rows [begin, end) thread t of a team of teamSize works on
+static inline void threadRows(int rowBegin, int rowEnd, int teamSize, int t, int* begin, int* end) {
+    int bandRows = (rowEnd - rowBegin) / teamSize;
+    int extra = (rowEnd - rowBegin) % teamSize;
+    *begin = rowBegin + t * bandRows + (t < extra ? t : extra);
+    *end = *begin + bandRows + (t < extra ? 1 : 0);
+}
+
+// Function to get the team size and the number of the calling thread
+static inline void teamPosition(int* teamSize, int* t) {
+#ifdef _OPENMP
+    *teamSize = omp_get_num_threads();
+    *t = omp_get_thread_num();
+#else
+    *teamSize = 1;
+    *t = 0;
+#endif
+}
+
+static inline int gcdOf(int a, int b) {
+    a = a < 0 ? -a : a;
+    b = b < 0 ? -b : b;
+    while (b != 0) {
+        int r = a % b;
+        a = b;
+        b = r;
+    }
+    return a;
+}
+
+// Function to try to factor the weights into column[y] * row[x], with row the first non-zero row of the
+// kernel divided by the greatest common divisor of its entries
+static inline int factorKernel(ConvolutionKernel* kernel) {
+    int size = kernel->size;
+    const int* w = kernel->weights;
+    int first = -1;
+    for (int i = 0; i < size * size && first < 0; i++) {
+        if (w[i] != 0) {
+            first = i / size;
+        }
+    }
+    if (first < 0 || size == 1) {
+        return 0;
+    }
+    int common = 0;
+    int pivot = -1;
+    for (int x = 0; x < size; x++) {
+        common = gcdOf(common, w[first * size + x]);
+        if (pivot < 0 && w[first * size + x] != 0) {
+            pivot = x;
+        }
+    }
+    for (int x = 0; x < size; x++) {
+        kernel->row[x] = w[first * size + x] / common;
+    }
+    for (int y = 0; y < size; y++) {
+        if (w[y * size + pivot] % kernel->row[pivot] != 0) {
+            return 0;
+        }
+        kernel->column[y] = w[y * size + pivot] / kernel->row[pivot];
+        for (int x = 0; x < size; x++) {
+            if (w[y * size + x] != kernel->column[y] * kernel->row[x]) {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+// Function to set up a kernel from size * size row-major weights. Returns 0 on success, -1 if size is not
+// odd and at most MAX_KERNEL_SIZE, the divisor is 0 or not below 2^20, a weight does not fit 16 bits
+// or a sum could overflow 32 bits.
+static inline int createConvolutionKernel(ConvolutionKernel* kernel, const int* weights, int size, int divisor) {
+    memset(kernel, 0, sizeof(*kernel));
+    if (size < 1 || size > MAX_KERNEL_SIZE || size % 2 == 0 || divisor == 0 || divisor >= (1 << 20) || divisor <= -(1 << 20)) {
+        return -1;
+    }
+    kernel->size = size;
+    kernel->radius = size / 2;
+    kernel->divisor = divisor;
+    double total = 0.0;
+    for (int i = 0; i < size * size; i++) {
+        if (weights[i] > 32767 || weights[i] < -32767) {
+            return -1;
+        }
+        kernel->weights[i] = weights[i];
+        total += weights[i] < 0 ? -weights[i] : weights[i];
+    }
+    if (total * 255.0 >= 2147483647.0) {
+        return -1;
+    }
+
+    kernel->separable = factorKernel(kernel);
+    double bytePass = 0.0;
+    for (int i = 0; i < (kernel->separable ? size : size * size); i++) {
+        int w = kernel->separable ? kernel->row[i] : kernel->weights[i];
+        bytePass += w < 0 ? -w : w;
+    }
+    kernel->narrow = bytePass * 255.0 <= 32767.0;
+    return 0;
+}
+
+// Function to set up one of the kernels the programs offer by name: edge (3x3 edge detection), box5 and
+// the binomial blurs gauss3, gauss5 and gauss7. Returns 0 on success, -1 for an unknown name.
+static inline int createNamedConvolutionKernel(ConvolutionKernel* kernel, const char* name) {
+    static const int binomial[][7] = {{1, 2, 1}, {1, 4, 6, 4, 1}, {1, 6, 15, 20, 15, 6, 1}};
+    int weights[7 * 7];
+    if (strcmp(name, "edge") == 0) {
+        static const int edge[9] = {-1, -1, -1, -1, 8, -1, -1, -1, -1};
+        return createConvolutionKernel(kernel, edge, 3, 1);
+    }
+    if (strcmp(name, "box5") == 0) {
+        for (int i = 0; i < 25; i++) {
+            weights[i] = 1;
+        }
+        return createConvolutionKernel(kernel, weights, 5, 25);
+    }
+    for (int b = 0; b < 3; b++) {
+        char gauss[8];
+        int size = 3 + 2 * b;
+        snprintf(gauss, sizeof(gauss), "gauss%d", size);
+        if (strcmp(name, gauss) == 0) {
+            for (int y = 0; y < size; y++) {
+                for (int x = 0; x < size; x++) {
+                    weights[y * size + x] = binomial[b][y] * binomial[b][x];
+                }
+            }
+            return createConvolutionKernel(kernel, weights, size, 1 << (4 * b + 4));
+        }
+    }
+    return -1;
+}
+
+// The kernels work on values [begin, count) of a row. A pass over bytes sums taps byte rows
+// times their weights into 32-bit sums, in 16-bit lanes if narrow; a pass over sums does the same with
+// rows of 32-bit sums, and finish divides, truncates and saturates the sums to bytes.
+typedef void (*ConvolutionBytePass)(const unsigned char* const* sources, const int* weights, int taps, size_t begin,
+                                    size_t count, int narrow, int* sums);
+typedef void (*ConvolutionSumPass)(const int* const* sources, const int* weights, int taps, size_t begin, size_t count,
+                                   int* sums);
+typedef void (*ConvolutionFinish)(const int* sums, size_t begin, size_t count, int divisor, unsigned char* out);
+
+static inline void convolutionBytesScalar(const unsigned char* const* sources, const int* weights, int taps, size_t begin,
+                                          size_t count, int narrow, int* sums) {
+    (void)narrow;
+    for (size_t x = begin; x < count; x++) {
+        int sum = 0;
+        for (int t = 0; t < taps; t++) {
+            sum += weights[t] * sources[t][x];
+        }
+        sums[x] = sum;
+    }
+}
+
+static inline void convolutionSumsScalar(const int* const* sources, const int* weights, int taps, size_t begin, size_t count,
+                                         int* sums) {
+    for (size_t x = begin; x < count; x++) {
+        int sum = 0;
+        for (int t = 0; t < taps; t++) {
+            sum += weights[t] * sources[t][x];
+        }
+        sums[x] = sum;
+    }
+}
+
+static inline void convolutionFinishScalar(const int* sums, size_t begin, size_t count, int divisor, unsigned char* out) {
+    for (size_t x = begin; x < count; x++) {
+        int value = sums[x] / divisor;
+        out[x] = (unsigned char)(value < 0 ? 0 : (value > 255 ? 255 : value));
+    }
+}
+
+// Function to get k if divisor is 2^k with k >= 1, 0 otherwise; such divisions are done with shifts
+static inline int divisorShift(int divisor) {
+    int shift = 0;
+    while (divisor > 1 && divisor % 2 == 0) {
+        divisor /= 2;
+        shift++;
+    }
+    return divisor == 1 ? shift : 0;
+}
+
+#ifdef CONVOLUTION_X86
+
+// Function to pack the weights of taps t and t + 1 (0 past the last tap) into a _mm_madd_epi16 pair
+static inline int tapPair(const int* weights, int t, int taps) {
+    unsigned second = t + 1 < taps ? (unsigned)weights[t + 1] : 0u;
+    return (int)(((unsigned)weights[t] & 0xFFFFu) | (second << 16));
+}
+
+// Two taps per step with 32-bit lanes: the bytes of both rows are interleaved into 16-bit pairs, so one
+// multiply-add applies both weights. An odd last tap is paired with a zero weight
+__attribute__((target("sse4.1")))
+static void convolutionBytesSse41(const unsigned char* const* sources, const int* weights, int taps, size_t begin,
+                                  size_t count, int narrow, int* sums) {
+    size_t x = begin;
+    for (; x + 8 <= count; x += 8) {
+        if (narrow) {
+            __m128i acc = _mm_setzero_si128();
+            for (int t = 0; t < taps; t++) {
+                __m128i v = _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i*)(sources[t] + x)));
+                acc = _mm_add_epi16(acc, _mm_mullo_epi16(v, _mm_set1_epi16((short)weights[t])));
+            }
+            _mm_storeu_si128((__m128i*)(sums + x), _mm_cvtepi16_epi32(acc));
+            _mm_storeu_si128((__m128i*)(sums + x + 4), _mm_cvtepi16_epi32(_mm_srli_si128(acc, 8)));
+        } else {
+            __m128i lo = _mm_setzero_si128(), hi = _mm_setzero_si128();
+            for (int t = 0; t < taps; t += 2) {
+                int second = t + 1 < taps ? t + 1 : t;
+                int pair = tapPair(weights, t, taps);
+                __m128i a = _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i*)(sources[t] + x)));
+                __m128i b = _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i*)(sources[second] + x)));
+                lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), _mm_set1_epi32(pair)));
+                hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), _mm_set1_epi32(pair)));
+            }
+            _mm_storeu_si128((__m128i*)(sums + x), lo);
+            _mm_storeu_si128((__m128i*)(sums + x + 4), hi);
+        }
+    }
+    convolutionBytesScalar(sources, weights, taps, x, count, narrow, sums);
+}
+
+__attribute__((target("sse4.1")))
+static void convolutionSumsSse41(const int* const* sources, const int* weights, int taps, size_t begin, size_t count,
+                                 int* sums) {
+    size_t x = begin;
+    for (; x + 4 <= count; x += 4) {
+        __m128i acc = _mm_setzero_si128();
+        for (int t = 0; t < taps; t++) {
+            __m128i v = _mm_loadu_si128((const __m128i*)(sources[t] + x));
+            acc = _mm_add_epi32(acc, _mm_mullo_epi32(v, _mm_set1_epi32(weights[t])));
+        }
+        _mm_storeu_si128((__m128i*)(sums + x), acc);
+    }
+    convolutionSumsScalar(sources, weights, taps, x, count, sums);
+}
+
+// Function to divide four sums truncating towards zero; the quotient of two doubles is exact enough that
+// truncating it gives the integer quotient for any sum and divisor below 2^31 and 2^20
+__attribute__((target("sse4.1")))
+static inline __m128i divideSse41(__m128i sums, __m128d divisor) {
+    __m128i lo = _mm_cvttpd_epi32(_mm_div_pd(_mm_cvtepi32_pd(sums), divisor));
+    __m128i hi = _mm_cvttpd_epi32(_mm_div_pd(_mm_cvtepi32_pd(_mm_srli_si128(sums, 8)), divisor));
+    return _mm_unpacklo_epi64(lo, hi);
+}
+
+__attribute__((target("sse4.1")))
+static void convolutionFinishSse41(const int* sums, size_t begin, size_t count, int divisor, unsigned char* out) {
+    const __m128d divisorV = _mm_set1_pd(divisor);
+    const int shift = divisorShift(divisor);
+    const __m128i shiftV = _mm_cvtsi32_si128(shift);
+    const __m128i bias = _mm_set1_epi32((1 << shift) - 1);
+    size_t x = begin;
+    for (; x + 8 <= count; x += 8) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(sums + x));
+        __m128i b = _mm_loadu_si128((const __m128i*)(sums + x + 4));
+        if (shift > 0) {
+            // Negative sums get 2^k - 1 added first, so the arithmetic shift truncates towards zero too
+            a = _mm_sra_epi32(_mm_add_epi32(a, _mm_and_si128(_mm_srai_epi32(a, 31), bias)), shiftV);
+            b = _mm_sra_epi32(_mm_add_epi32(b, _mm_and_si128(_mm_srai_epi32(b, 31), bias)), shiftV);
+        } else if (divisor != 1) {
+            a = divideSse41(a, divisorV);
+            b = divideSse41(b, divisorV);
+        }
+        __m128i words = _mm_packs_epi32(a, b);
+        _mm_storel_epi64((__m128i*)(out + x), _mm_packus_epi16(words, words));
+    }
+    convolutionFinishScalar(sums, x, count, divisor, out);
+}
+
+// The same on 16 values per step. The unpacks work inside 128-bit lanes, so the two accumulators of the
+// 32-bit path hold values 0-3, 8-11 and 4-7, 12-15 and are put back in order when stored
+__attribute__((target("avx2")))
+static void convolutionBytesAvx2(const unsigned char* const* sources, const int* weights, int taps, size_t begin,
+                                 size_t count, int narrow, int* sums) {
+    size_t x = begin;
+    for (; x + 16 <= count; x += 16) {
+        if (narrow) {
+            __m256i acc = _mm256_setzero_si256();
+            for (int t = 0; t < taps; t++) {
+                __m256i v = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(sources[t] + x)));
+                acc = _mm256_add_epi16(acc, _mm256_mullo_epi16(v, _mm256_set1_epi16((short)weights[t])));
+            }
+            _mm256_storeu_si256((__m256i*)(sums + x), _mm256_cvtepi16_epi32(_mm256_castsi256_si128(acc)));
+            _mm256_storeu_si256((__m256i*)(sums + x + 8), _mm256_cvtepi16_epi32(_mm256_extracti128_si256(acc, 1)));
+        } else {
+            __m256i lo = _mm256_setzero_si256(), hi = _mm256_setzero_si256();
+            for (int t = 0; t < taps; t += 2) {
+                int second = t + 1 < taps ? t + 1 : t;
+                int pair = tapPair(weights, t, taps);
+                __m256i a = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(sources[t] + x)));
+                __m256i b = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(sources[second] + x)));
+                lo = _mm256_add_epi32(lo, _mm256_madd_epi16(_mm256_unpacklo_epi16(a, b), _mm256_set1_epi32(pair)));
+                hi = _mm256_add_epi32(hi, _mm256_madd_epi16(_mm256_unpackhi_epi16(a, b), _mm256_set1_epi32(pair)));
+            }
+            _mm256_storeu_si256((__m256i*)(sums + x), _mm256_permute2x128_si256(lo, hi, 0x20));
+            _mm256_storeu_si256((__m256i*)(sums + x + 8), _mm256_permute2x128_si256(lo, hi, 0x31));
+        }
+    }
+    convolutionBytesScalar(sources, weights, taps, x, count, narrow, sums);
+}
+
+__attribute__((target("avx2")))
+static void convolutionSumsAvx2(const int* const* sources, const int* weights, int taps, size_t begin, size_t count,
+                                int* sums) {
+    size_t x = begin;
+    for (; x + 8 <= count; x += 8) {
+        __m256i acc = _mm256_setzero_si256();
+        for (int t = 0; t < taps; t++) {
+            __m256i v = _mm256_loadu_si256((const __m256i*)(sources[t] + x));
+            acc = _mm256_add_epi32(acc, _mm256_mullo_epi32(v, _mm256_set1_epi32(weights[t])));
+        }
+        _mm256_storeu_si256((__m256i*)(sums + x), acc);
+    }
+    convolutionSumsScalar(sources, weights, taps, x, count, sums);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i divideAvx2(__m256i sums, __m256d divisor) {
+    __m128i lo = _mm256_cvttpd_epi32(_mm256_div_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(sums)), divisor));
+    __m128i hi = _mm256_cvttpd_epi32(_mm256_div_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(sums, 1)), divisor));
+    return _mm256_set_m128i(hi, lo);
+}
+
+__attribute__((target("avx2")))
+static void convolutionFinishAvx2(const int* sums, size_t begin, size_t count, int divisor, unsigned char* out) {
+    const __m256d divisorV = _mm256_set1_pd(divisor);
+    const int shift = divisorShift(divisor);
+    const __m128i shiftV = _mm_cvtsi32_si128(shift);
+    const __m256i bias = _mm256_set1_epi32((1 << shift) - 1);
+    size_t x = begin;
+    for (; x + 16 <= count; x += 16) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(sums + x));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(sums + x + 8));
+        if (shift > 0) {
+            a = _mm256_sra_epi32(_mm256_add_epi32(a, _mm256_and_si256(_mm256_srai_epi32(a, 31), bias)), shiftV);
+            b = _mm256_sra_epi32(_mm256_add_epi32(b, _mm256_and_si256(_mm256_srai_epi32(b, 31), bias)), shiftV);
+        } else if (divisor != 1) {
+            a = divideAvx2(a, divisorV);
+            b = divideAvx2(b, divisorV);
+        }
+        // packs interleaves the lanes of a and b; the permute restores 0-15 before the bytes are packed
+        __m256i words = _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xD8);
+        __m256i bytes = _mm256_packus_epi16(words, words);
+        _mm_storel_epi64((__m128i*)(out + x), _mm256_castsi256_si128(bytes));
+        _mm_storel_epi64((__m128i*)(out + x + 8), _mm256_extracti128_si256(bytes, 1));
+    }
+    convolutionFinishScalar(sums, x, count, divisor, out);
+}
+
+#endif // CONVOLUTION_X86
+
+typedef struct {
+    const char* name;
+    ConvolutionBytePass bytes;
+    ConvolutionSumPass sums;
+    ConvolutionFinish finish;
+} ConvolutionSimd;
+
+// Function to pick the widest kernel the CPU supports (or the one named in UPSCALE_SIMD)
+static inline const ConvolutionSimd* selectConvolutionSimd(void) {
+    static const ConvolutionSimd kernels[] = {
+#ifdef CONVOLUTION_X86
+        {"avx2", convolutionBytesAvx2, convolutionSumsAvx2, convolutionFinishAvx2},
+        {"sse41", convolutionBytesSse41, convolutionSumsSse41, convolutionFinishSse41},
+#endif
+        {"scalar", convolutionBytesScalar, convolutionSumsScalar, convolutionFinishScalar},
+    };
+    static const ConvolutionSimd* selected = NULL;
+    if (selected != NULL) {
+        return selected;
+    }
+
+    int count = sizeof(kernels) / sizeof(kernels[0]);
+    int supported[sizeof(kernels) / sizeof(kernels[0])];
+    for (int k = 0; k < count; k++) {
+        supported[k] = 1;
+    }
+#ifdef CONVOLUTION_X86
+    __builtin_cpu_init();
+    supported[0] = __builtin_cpu_supports("avx2");
+    supported[1] = __builtin_cpu_supports("sse4.1");
+#endif
+
+    const char* forced = getenv("UPSCALE_SIMD");
+    if (forced != NULL && strcmp(forced, "double") == 0) {
+        forced = "scalar";
+    }
+    for (int k = 0; k < count && forced != NULL; k++) {
+        if (strcmp(forced, kernels[k].name) == 0 && supported[k]) {
+            selected = &kernels[k];
+            return selected;
+        }
+    }
+    for (int k = 0; k < count; k++) {
+        if (supported[k]) {
+            selected = &kernels[k];
+            break;
+        }
+    }
+    return selected;
+}
+
+// State of one thread convolving consecutive rows of one image (or plane). A separable kernel keeps the
+// row pass of the last size rows in a ring, slot y % size holding row y once filteredRow[y % size] == y,
+// so every row goes through the row pass once
+typedef struct {
+    const ConvolutionKernel* kernel;
+    const ConvolutionSimd* simd;
+    int step;           // Bytes from a value to the same channel of the next pixel
+    size_t rowBytes;
+    size_t begin, end;  // Bytes of a row that have a full neighbourhood
+    int* sums;          // rowBytes sums
+    int* filtered;      // Separable kernels: size rows of rowBytes row-pass sums
+    int filteredRow[MAX_KERNEL_SIZE];
+} ConvolutionWorker;
+
+// Function to set up a worker for rows of width pixels, channels bytes apart. Returns 0 on success, -1 if
+// the buffers could not be allocated.
+static inline int createConvolutionWorker(ConvolutionWorker* worker, const ConvolutionKernel* kernel, int width, int channels) {
+    memset(worker, 0, sizeof(*worker));
+    worker->kernel = kernel;
+    worker->simd = selectConvolutionSimd();
+    worker->step = channels;
+    worker->rowBytes = (size_t)width * channels;
+    worker->begin = (size_t)kernel->radius * channels;
+    worker->end = width > 2 * kernel->radius ? (size_t)(width - kernel->radius) * channels : worker->begin;
+    worker->sums = (int*)malloc(worker->rowBytes * sizeof(int));
+    if (kernel->separable) {
+        worker->filtered = (int*)malloc((size_t)kernel->size * worker->rowBytes * sizeof(int));
+    }
+    for (int m = 0; m < MAX_KERNEL_SIZE; m++) {
+        worker->filteredRow[m] = -1;
+    }
+    return worker->sums != NULL && (!kernel->separable || worker->filtered != NULL) ? 0 : -1;
+}
+
+static inline void destroyConvolutionWorker(ConvolutionWorker* worker) {
+    free(worker->sums);
+    free(worker->filtered);
+    worker->sums = NULL;
+    worker->filtered = NULL;
+}
+
+// Function to convolve row y into out (only its bytes with a full neighbourhood are written). rows are the
+// size rows from y - radius to y + radius; a worker of a separable kernel reuses the row pass of the rows it
+// has seen, so it must be fed the rows of one image only
+static inline void convolveWorkerRow(ConvolutionWorker* worker, const unsigned char* const* rows, int y, unsigned char* out) {
+    const ConvolutionKernel* kernel = worker->kernel;
+    int size = kernel->size;
+    int radius = kernel->radius;
+    const unsigned char* byteSources[MAX_KERNEL_SIZE * MAX_KERNEL_SIZE];
+    const int* sumSources[MAX_KERNEL_SIZE];
+    int weights[MAX_KERNEL_SIZE * MAX_KERNEL_SIZE];
+    int taps = 0;
+    if (worker->end <= worker->begin) {
+        return;
+    }
+
+    if (kernel->separable) {
+        // Row pass of the rows not in the ring yet, then the column pass over the ring
+        for (int m = 0; m < size; m++) {
+            int row = y - radius + m;
+            int slot = row % size;
+            int* filtered = worker->filtered + (size_t)slot * worker->rowBytes;
+            if (worker->filteredRow[slot] != row) {
+                int rowWeights[MAX_KERNEL_SIZE];
+                int rowTaps = 0;
+                for (int kx = 0; kx < size; kx++) {
+                    if (kernel->row[kx] != 0) {
+                        byteSources[rowTaps] = rows[m] + (kx - radius) * worker->step;
+                        rowWeights[rowTaps++] = kernel->row[kx];
+                    }
+                }
+                worker->simd->bytes(byteSources, rowWeights, rowTaps, worker->begin, worker->end, kernel->narrow, filtered);
+                worker->filteredRow[slot] = row;
+            }
+            if (kernel->column[m] != 0) {
+                sumSources[taps] = filtered;
+                weights[taps++] = kernel->column[m];
+            }
+        }
+        worker->simd->sums(sumSources, weights, taps, worker->begin, worker->end, worker->sums);
+    } else {
+        for (int m = 0; m < size; m++) {
+            for (int kx = 0; kx < size; kx++) {
+                if (kernel->weights[m * size + kx] != 0) {
+                    byteSources[taps] = rows[m] + (kx - radius) * worker->step;
+                    weights[taps++] = kernel->weights[m * size + kx];
+                }
+            }
+        }
+        worker->simd->bytes(byteSources, weights, taps, worker->begin, worker->end, kernel->narrow, worker->sums);
+    }
+    worker->simd->finish(worker->sums, worker->begin, worker->end, kernel->divisor, out);
+}
+
+// Function to convolve output rows [rowBegin, rowEnd) of a width x height image with channels interleaved
+// channels. input points at image row inputRowBegin and holds the rows after it (at least rows rowBegin - radius
+// to rowEnd + radius - 1, as far as they exist) and output receives the band, starting with row rowBegin; the
+// strides are the bytes from one row to the next, negative for bottom-up storage. The
+// border of radius pixels has no full neighbourhood and is left untouched. Every thread convolves one
+// contiguous band of the rows. Returns 0 on success, -1 if the buffers could not be allocated.
+static inline int convolveImageRows(const unsigned char* input, ptrdiff_t inputStride, unsigned char* output,
+                                    ptrdiff_t outputStride, int width, int height, int channels,
+                                    const ConvolutionKernel* kernel, int rowBegin, int rowEnd, int inputRowBegin) {
+    int radius = kernel->radius;
+    int first = rowBegin > radius ? rowBegin : radius;
+    int last = rowEnd < height - radius ? rowEnd : height - radius;
+    int failed = 0;
+    if (last <= first) {
+        return 0;
+    }
+    selectConvolutionSimd();
+
+#ifdef _OPENMP
+    #pragma omp parallel reduction(|| : failed)
+#endif
+    {
+        int teamSize, t, begin, end;
+        teamPosition(&teamSize, &t);
+        threadRows(first, last, teamSize, t, &begin, &end);
+
+        ConvolutionWorker worker;
+        if (createConvolutionWorker(&worker, kernel, width, channels) != 0) {
+            failed = end > begin;
+        } else {
+            const unsigned char* rows[MAX_KERNEL_SIZE];
+            for (int y = begin; y < end; y++) {
+                for (int m = 0; m < kernel->size; m++) {
+                    rows[m] = input + (y - radius + m - inputRowBegin) * inputStride;
+                }
+                convolveWorkerRow(&worker, rows, y, output + (y - rowBegin) * outputStride);
+            }
+        }
+        destroyConvolutionWorker(&worker);
+    }
+    return failed ? -1 : 0;
+}
+
+// Function to convolve a whole image in either layout; a planar image is convolved plane by plane.
+// Returns 0 on success, -1 if the buffers could not be allocated.
+static inline int convolveImage(const unsigned char* input, unsigned char* output, int width, int height, int channels,
+                                ImageLayout layout, const ConvolutionKernel* kernel) {
+    if (layout == LAYOUT_INTERLEAVED) {
+        ptrdiff_t rowBytes = (ptrdiff_t)width * channels;
+        return convolveImageRows(input, rowBytes, output, rowBytes, width, height, channels, kernel, 0, height, 0);
+    }
+    size_t planeBytes = (size_t)width * height;
+    for (int c = 0; c < channels; c++) {
+        if (convolveImageRows(input + c * planeBytes, width, output + c * planeBytes, width, width, height, 1, kernel, 0,
+                              height, 0) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+#endif // UPSCALE_CONVOLUTION_H
@@ -0,0 +1,338 @@
+/*
+ * Programmer(s) : Syed Saad Ullah Hussaini, K214703 Ali Raza, K213100 Muhammad Sameed
+ * Date: 17 October 2026
+ * Desc: Bicubic upscaling of interleaved 8-bit images, shared by upscale_omp
+ *       and upscale_mpi, on its own or fused with the convolution engine of
+ *       upscale_convolution.h. It works on a band of output rows, so a rank or
+ *       a thread can produce its own rows from only the source rows they touch
+ *       (sourceRowsOfBand). The passes run on the fixed-point SIMD kernels of
+ *       upscale_simd.h. Rows are addressed with byte strides, so the images can
+ *       be read and written in place in mapped BMP files (bmp_io.h).
+ */
+
+#ifndef UPSCALE_KERNELS_H
+#define UPSCALE_KERNELS_H
+
+#include <math.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include "upscale_simd.h"
+#include "upscale_convolution.h"
+
+static inline int max(int a, int b) {
+    return (a > b) ? a : b;
+}
+
+static inline int min(int a, int b) {
+    return (a < b) ? a : b;
+}
+
+static inline int clamp(double x, int minVal, int maxVal) {
+    return (int)(x < minVal ? minVal : (x > maxVal ? maxVal : x));
+}
+
+static inline double cubicHermite(double A, double B, double C, double D, double t) {
+    double a = -A/2.0 + (3.0*B)/2.0 - (3.0*C)/2.0 + D/2.0;
+    double b = A - (5.0*B)/2.0 + 2.0*C - D / 2.0;
+    double c = -A/2.0 + C/2.0;
+    double d = B;
+
+    return a*t*t*t + b*t*t + c*t + d;
+}
+
+// Function to get the source row the bicubic stencil of output row i is centred on; the stencil reads
+// the rows from one above to two below it, clamped to the image
+static inline int bicubicSourceRow(int height, int newHeight, int i) {
+    double y_ratio = ((double)(height-1))/newHeight;
+    return (int)(y_ratio * i);
+}
+
+// Function to get the source rows [first, last) that output rows [rowBegin, rowEnd) read
+static inline void sourceRowsOfBand(int height, int newHeight, int rowBegin, int rowEnd, int* first, int* last) {
+    *first = max(bicubicSourceRow(height, newHeight, rowBegin) - 1, 0);
+    *last = min(bicubicSourceRow(height, newHeight, rowEnd - 1) + 3, height);
+}
+
+// Taps of the separable bicubic filter: for every output column (or row) the four clamped source columns
+// (rows) it reads and their weights. The edge clamping lives in the indices, so the loops that use the
+// taps have no branches
+typedef struct {
+    int* index;          // 4 entries per output column or row
+    double* weight;      // 4 entries per output column or row
+    short* fixedWeight;  // The same weights in Q14, rounded so that every four sum to exactly 1 << 14
+} BicubicTaps;
+
+static inline void freeBicubicTaps(BicubicTaps* taps) {
+    free(taps->index);
+    free(taps->weight);
+    free(taps->fixedWeight);
+    taps->index = NULL;
+    taps->weight = NULL;
+    taps->fixedWeight = NULL;
+}
+
+// Function to compute the taps of outputs [begin, end) of a source axis of size source scaled to size target.
+// The weight of every source sample is cubicHermite with that sample set to one and the others to zero.
+// Returns 0 on success, -1 if the tables could not be allocated.
+static inline int createBicubicTaps(BicubicTaps* taps, int source, int target, int begin, int end) {
+    int count = end > begin ? end - begin : 1;
+    taps->index = (int*)malloc(4 * (size_t)count * sizeof(int));
+    taps->weight = (double*)malloc(4 * (size_t)count * sizeof(double));
+    taps->fixedWeight = (short*)malloc(4 * (size_t)count * sizeof(short));
+    if (taps->index == NULL || taps->weight == NULL || taps->fixedWeight == NULL) {
+        freeBicubicTaps(taps);
+        return -1;
+    }
+    double ratio = ((double)(source-1))/target;
+    for (int i = begin; i < end; i++) {
+        double p = ratio * i;
+        int centre = (int)p;
+        double t = p - centre;
+        int* index = taps->index + 4 * (size_t)(i - begin);
+        double* weight = taps->weight + 4 * (size_t)(i - begin);
+        short* fixedWeight = taps->fixedWeight + 4 * (size_t)(i - begin);
+        for (int m = 0; m < 4; m++) {
+            index[m] = min(max(centre + m - 1, 0), source - 1);
+        }
+        weight[0] = cubicHermite(1.0, 0.0, 0.0, 0.0, t);
+        weight[1] = cubicHermite(0.0, 1.0, 0.0, 0.0, t);
+        weight[2] = cubicHermite(0.0, 0.0, 1.0, 0.0, t);
+        weight[3] = cubicHermite(0.0, 0.0, 0.0, 1.0, t);
+
+        // The rounding error goes to the larger of the two centre weights, so flat areas stay exact
+        int sum = 0;
+        for (int m = 0; m < 4; m++) {
+            fixedWeight[m] = (short)lround(weight[m] * (1 << BICUBIC_WEIGHT_BITS));
+            sum += fixedWeight[m];
+        }
+        fixedWeight[weight[1] >= weight[2] ? 1 : 2] += (short)((1 << BICUBIC_WEIGHT_BITS) - sum);
+    }
+    return 0;
+}
+
+// Function to filter one source row horizontally into newWidth * channels doubles
+static inline void bicubicHorizontal(const unsigned char* row, double* filtered, const BicubicTaps* columns, int channels,
+                                     int newWidth) {
+    for (int j = 0; j < newWidth; j++) {
+        const int* index = columns->index + 4 * (size_t)j;
+        const double* weight = columns->weight + 4 * (size_t)j;
+        const unsigned char* s0 = row + (size_t)index[0] * channels;
+        const unsigned char* s1 = row + (size_t)index[1] * channels;
+        const unsigned char* s2 = row + (size_t)index[2] * channels;
+        const unsigned char* s3 = row + (size_t)index[3] * channels;
+        for (int k = 0; k < channels; k++) {
+            filtered[(size_t)j * channels + k] = weight[0] * s0[k] + weight[1] * s1[k] + weight[2] * s2[k] + weight[3] * s3[k];
+        }
+    }
+}
+
+// Everything a thread needs to upscale its band of rows
+typedef struct {
+    const unsigned char* input;  // Source row sourceRowBegin
+    ptrdiff_t inputStride;       // Bytes from a source row to the one below it, negative for bottom-up storage
+    int width, newWidth, channels;
+    int rowBegin, sourceRowBegin;
+    const BicubicTaps* columns;
+    const BicubicTaps* rows;     // Taps of the output rows from rowBegin on
+} BicubicJob;
+
+// Four horizontally filtered source rows of one thread: slot r % 4 holds source row r once
+// ringRow[r % 4] == r, so every source row of a band is filtered once
+typedef struct {
+    void* data;  // 4 rows of newWidth * channels doubles (double path) or shorts (fixed-point path)
+    int ringRow[4];
+} BicubicRing;
+
+// Function to allocate the ring of a thread. Returns 0 on success, -1 if it could not be allocated.
+static inline int createBicubicRing(BicubicRing* ring, const BicubicJob* job, const BicubicKernelInfo* kernel) {
+    size_t elementSize = kernel->row != NULL ? sizeof(short) : sizeof(double);
+    ring->data = malloc(4 * (size_t)job->newWidth * job->channels * elementSize);
+    for (int m = 0; m < 4; m++) {
+        ring->ringRow[m] = -1;
+    }
+    return ring->data != NULL ? 0 : -1;
+}
+
+// Function to upscale output row i of a job into out, filtering the source rows it needs into the ring
+static inline void bicubicRow(const BicubicJob* job, const BicubicKernelInfo* kernel, BicubicRing* ring, int i,
+                              unsigned char* out) {
+    size_t rowBytes = (size_t)job->newWidth * job->channels;
+    const int* index = job->rows->index + 4 * (size_t)(i - job->rowBegin);
+    int slots[4];
+    for (int m = 0; m < 4; m++) {
+        int slot = index[m] % 4;
+        if (ring->ringRow[slot] != index[m]) {
+            const unsigned char* source = job->input + (index[m] - job->sourceRowBegin) * job->inputStride;
+            if (kernel->row != NULL) {
+                kernel->row(source, (short*)ring->data + slot * rowBytes, job->columns->index, job->columns->fixedWeight,
+                            job->width, job->newWidth, job->channels);
+            } else {
+                bicubicHorizontal(source, (double*)ring->data + slot * rowBytes, job->columns, job->channels, job->newWidth);
+            }
+            ring->ringRow[slot] = index[m];
+        }
+        slots[m] = slot;
+    }
+
+    if (kernel->row != NULL) {
+        const short* filtered[4];
+        for (int m = 0; m < 4; m++) {
+            filtered[m] = (const short*)ring->data + slots[m] * rowBytes;
+        }
+        kernel->column(filtered, job->rows->fixedWeight + 4 * (size_t)(i - job->rowBegin), out, rowBytes);
+    } else {
+        const double* weight = job->rows->weight + 4 * (size_t)(i - job->rowBegin);
+        const double* filtered[4];
+        for (int m = 0; m < 4; m++) {
+            filtered[m] = (const double*)ring->data + slots[m] * rowBytes;
+        }
+        for (size_t x = 0; x < rowBytes; x++) {
+            double value = weight[0] * filtered[0][x] + weight[1] * filtered[1][x] + weight[2] * filtered[2][x] +
+                           weight[3] * filtered[3][x];
+            out[x] = (unsigned char)clamp(value, 0, 255);
+        }
+    }
+}
+
+// Function to create the taps of a job for output rows [rowBegin, rowEnd). Returns 0 on success, -1 if the
+// tables could not be allocated.
+static inline int createBicubicJob(BicubicJob* job, BicubicTaps* columns, BicubicTaps* rows, const unsigned char* input,
+                                   ptrdiff_t inputStride, int width, int height, int channels, int newWidth, int newHeight,
+                                   int rowBegin, int rowEnd, int sourceRowBegin) {
+    if (createBicubicTaps(columns, width, newWidth, 0, newWidth) != 0) {
+        return -1;
+    }
+    if (createBicubicTaps(rows, height, newHeight, rowBegin, rowEnd) != 0) {
+        freeBicubicTaps(columns);
+        return -1;
+    }
+    BicubicJob value = {input, inputStride, width, newWidth, channels, rowBegin, sourceRowBegin, columns, rows};
+    *job = value;
+    return 0;
+}
+
+// Function to upscale output rows [rowBegin, rowEnd) in two separable passes, horizontal then vertical.
+// input points at source row sourceRowBegin and holds the rows after it (at least the rows sourceRowsOfBand
+// returns), output receives the band, starting with row rowBegin; the strides are the bytes from one row to
+// the next and may be negative or include padding, as in a mapped bottom-up BMP. The rows are split into one contiguous band per thread;
+// a thread filters each source row of its band horizontally once, into a ring of the last four filtered
+// rows, and every output row is then a four-tap vertical sum of that ring. The passes run in 16-bit fixed
+// point with the SIMD kernel of selectBicubicKernel, or in double with UPSCALE_SIMD=double.
+// Returns 0 on success, -1 if the tables or the rings could not be allocated.
+static inline int bicubicInterpolateRows(const unsigned char* input, ptrdiff_t inputStride, unsigned char* output,
+                                         ptrdiff_t outputStride, int width, int height, int channels, int newWidth,
+                                         int newHeight, int rowBegin, int rowEnd, int sourceRowBegin) {
+    BicubicTaps columns, rows;
+    BicubicJob job;
+    if (createBicubicJob(&job, &columns, &rows, input, inputStride, width, height, channels, newWidth, newHeight, rowBegin,
+                         rowEnd, sourceRowBegin) != 0) {
+        return -1;
+    }
+    const BicubicKernelInfo* kernel = selectBicubicKernel();
+    int failed = 0;
+
+#ifdef _OPENMP
+    #pragma omp parallel reduction(|| : failed)
+#endif
+    {
+        int teamSize, t, begin, end;
+        teamPosition(&teamSize, &t);
+        threadRows(rowBegin, rowEnd, teamSize, t, &begin, &end);
+        BicubicRing ring;
+        if (createBicubicRing(&ring, &job, kernel) != 0) {
+            failed = end > begin;
+        } else {
+            for (int i = begin; i < end; i++) {
+                bicubicRow(&job, kernel, &ring, i, output + (i - rowBegin) * outputStride);
+            }
+        }
+        free(ring.data);
+    }
+
+    freeBicubicTaps(&columns);
+    freeBicubicTaps(&rows);
+    return failed ? -1 : 0;
+}
+
+static inline int bicubicInterpolate(const unsigned char* input, unsigned char* output, int width, int height, int channels,
+                                     int newWidth, int newHeight) {
+    return bicubicInterpolateRows(input, (ptrdiff_t)width * channels, output, (ptrdiff_t)newWidth * channels, width, height,
+                                  channels, newWidth, newHeight, 0, newHeight, 0);
+}
+
+// Function to upscale and convolve output rows [rowBegin, rowEnd) in one pass, without the full-size upscaled
+// image: every thread takes a band of these rows, upscales them one at a time (plus radius rows above and
+// below its band) into a ring of kernel size rows and convolves each row as soon as the last row it needs is
+// ready, while they are all still in cache. input points at the top source row and output at the top row of
+// the whole newWidth x newHeight output, both with the byte strides of their rows (negative for bottom-up
+// storage). Only the convolved rows are written; the border is left untouched as with convolveImageRows.
+// Calling it strip by strip keeps the touched part of the images small. Returns 0 on success, -1 if the
+// buffers could not be allocated.
+static inline int upscaleAndConvolveRows(const unsigned char* input, ptrdiff_t inputStride, unsigned char* output,
+                                         ptrdiff_t outputStride, int width, int height, int channels, int newWidth,
+                                         int newHeight, const ConvolutionKernel* kernel, int rowBegin, int rowEnd) {
+    int radius = kernel->radius;
+    int first = max(rowBegin, radius);
+    int last = min(rowEnd, newHeight - radius);
+    if (last <= first) {
+        return 0;
+    }
+    BicubicTaps columns, rows;
+    BicubicJob job;
+    if (createBicubicJob(&job, &columns, &rows, input, inputStride, width, height, channels, newWidth, newHeight,
+                         first - radius, last + radius, 0) != 0) {
+        return -1;
+    }
+    const BicubicKernelInfo* bicubic = selectBicubicKernel();
+    selectConvolutionSimd();
+    int size = kernel->size;
+    size_t rowBytes = (size_t)newWidth * channels;
+    int failed = 0;
+
+#ifdef _OPENMP
+    #pragma omp parallel reduction(|| : failed)
+#endif
+    {
+        // Convolved rows of this thread; the border rows are never convolved
+        int teamSize, t, begin, end;
+        teamPosition(&teamSize, &t);
+        threadRows(first, last, teamSize, t, &begin, &end);
+        BicubicRing ring;
+        ConvolutionWorker worker;
+        unsigned char* upscaled = (unsigned char*)malloc((size_t)size * rowBytes);
+        int ready = createBicubicRing(&ring, &job, bicubic) == 0;
+        ready = createConvolutionWorker(&worker, kernel, newWidth, channels) == 0 && ready;
+        if (!ready || upscaled == NULL) {
+            failed = end > begin;
+        } else if (end > begin) {
+            // Upscaled row y sits in slot y % size; row y - radius is convolved once row y is in
+            const unsigned char* window[MAX_KERNEL_SIZE];
+            for (int y = begin - radius; y < end + radius; y++) {
+                bicubicRow(&job, bicubic, &ring, y, upscaled + (size_t)(y % size) * rowBytes);
+                int centre = y - radius;
+                if (centre >= begin) {
+                    for (int m = 0; m < size; m++) {
+                        window[m] = upscaled + (size_t)((centre - radius + m) % size) * rowBytes;
+                    }
+                    convolveWorkerRow(&worker, window, centre, output + centre * outputStride);
+                }
+            }
+        }
+        free(ring.data);
+        destroyConvolutionWorker(&worker);
+        free(upscaled);
+    }
+
+    freeBicubicTaps(&columns);
+    freeBicubicTaps(&rows);
+    return failed ? -1 : 0;
+}
+
+// Function to upscale and convolve a whole image stored with packed rows
+static inline int upscaleAndConvolve(const unsigned char* input, unsigned char* output, int width, int height, int channels,
+                                     int newWidth, int newHeight, const ConvolutionKernel* kernel) {
+    return upscaleAndConvolveRows(input, (ptrdiff_t)width * channels, output, (ptrdiff_t)newWidth * channels, width, height,
+                                  channels, newWidth, newHeight, kernel, 0, newHeight);
+}
+
+#endif // UPSCALE_KERNELS_H
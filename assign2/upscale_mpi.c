@@ -1,53 +1,52 @@
 #include <mpi.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include "bmp_io.h"
+#include "upscale_kernels.h"
+
+// Function to create the datatype of one image row of rowBytes bytes whose successor starts stride bytes
+// further (negative for the bottom-up rows of a BMP), so a scatter or gather can address a padded file in
+// whole rows
+MPI_Datatype createRowType(int rowBytes, ptrdiff_t stride) {
+    MPI_Datatype row, strided;
+    MPI_Type_contiguous(rowBytes, MPI_UNSIGNED_CHAR, &row);
+    MPI_Type_create_resized(row, 0, (MPI_Aint)stride, &strided);
+    MPI_Type_commit(&strided);
+    MPI_Type_free(&row);
+    return strided;
+}
 
-#pragma pack(push, 1)
-typedef struct {
-    unsigned short type;
-    unsigned int size;
-    unsigned short reserved1, reserved2;
-    unsigned int offset;
-} BMPHeader;
-
-typedef struct {
-    unsigned int size;
-    int width, height;
-    unsigned short planes;
-    unsigned short bitCount;
-    unsigned int compression;
-    unsigned int imageSize;
-    int xPelsPerMeter, yPelsPerMeter;
-    unsigned int clrUsed, clrImportant;
-} BMPInfoHeader;
-#pragma pack(pop)
-
-unsigned char* loadBMP(const char* filename, BMPHeader* header, BMPInfoHeader* infoHeader) {
-    FILE* file = fopen(filename, "rb");
-    if (!file) return NULL;
-
-    fread(header, sizeof(BMPHeader), 1, file);
-    fread(infoHeader, sizeof(BMPInfoHeader), 1, file);
-    if (header->type != 0x4D42) {
-        fclose(file);
-        return NULL;
-    }
-
-    unsigned char* data = (unsigned char*)malloc(infoHeader->imageSize);
-    fseek(file, header->offset, SEEK_SET);
-    fread(data, infoHeader->imageSize, 1, file);
-    fclose(file);
+// Function to get the output rows [begin, end) of a rank; the first newHeight % size ranks get one extra row
+void outputBand(int newHeight, int size, int rank, int* begin, int* end) {
+    int local_height = newHeight / size;
+    int extra = newHeight % size;
+    *begin = rank * local_height + (rank < extra ? rank : extra);
+    *end = *begin + local_height + (rank < extra ? 1 : 0);
+}
 
-    return data;
+// Function to get the source rows [begin, end) a rank owns: from the row its first output row is centred
+// on up to the one of the next rank, so the bands tile the source image without overlap
+void sourceBand(int height, int newHeight, int size, int rank, int* begin, int* end) {
+    int outBegin, outEnd, nextBegin, nextEnd;
+    outputBand(newHeight, size, rank, &outBegin, &outEnd);
+    *begin = rank == 0 ? 0 : bicubicSourceRow(height, newHeight, outBegin);
+    if (rank == size - 1) {
+        *end = height;
+    } else {
+        outputBand(newHeight, size, rank + 1, &nextBegin, &nextEnd);
+        *end = bicubicSourceRow(height, newHeight, nextBegin);
+    }
 }
 
-void saveBMP(const char* filename, BMPHeader* header, BMPInfoHeader* infoHeader, unsigned char* data) {
-    FILE* file = fopen(filename, "wb");
-    fwrite(header, sizeof(BMPHeader), 1, file);
-    fwrite(infoHeader, sizeof(BMPInfoHeader), 1, file);
-    fseek(file, header->offset, SEEK_SET);
-    fwrite(data, infoHeader->imageSize, 1, file);
-    fclose(file);
+// Function to get how many source rows a rank needs from the ranks above and below it: the bicubic stencil
+// reaches one row above its band and up to three rows below it (two below the centre row)
+void sourceHalo(int height, int newHeight, int size, int rank, int* above, int* below) {
+    int outBegin, outEnd, begin, end, first, last;
+    outputBand(newHeight, size, rank, &outBegin, &outEnd);
+    sourceBand(height, newHeight, size, rank, &begin, &end);
+    sourceRowsOfBand(height, newHeight, outBegin, outEnd, &first, &last);
+    *above = begin - first;
+    *below = last > end ? last - end : 0;
 }
 
 int main(int argc, char* argv[]) {
@@ -64,64 +63,159 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
-    BMPHeader header;
-    BMPInfoHeader infoHeader;
-    unsigned char* inputData = NULL;
+    // Root maps the input file and scatters straight from the mapping
+    BMPImage input, output;
+    int dimensions[3];
     if (rank == 0) {
-        inputData = loadBMP(argv[1], &header, &infoHeader);
-        if (!inputData) {
+        if (openBMP(argv[1], &input) != 0) {
             printf("Failed to load image\n");
             MPI_Abort(MPI_COMM_WORLD, 1);
         }
+        dimensions[0] = input.view.width;
+        dimensions[1] = input.view.height;
+        dimensions[2] = input.view.channels;
     }
 
-    MPI_Bcast(&infoHeader, sizeof(infoHeader), MPI_BYTE, 0, MPI_COMM_WORLD);
+    MPI_Bcast(dimensions, 3, MPI_INT, 0, MPI_COMM_WORLD);
 
     int upscale_factor = 2; // Define your upscale factor
-    int newWidth = infoHeader.width * upscale_factor;
-    int newHeight = infoHeader.height * upscale_factor;
-    int newRowSize = (newWidth * infoHeader.bitCount + 31) / 32 * 4;
-    int newImageSize = newHeight * newRowSize;
-
-    unsigned char* outputData = malloc(newImageSize);
+    int width = dimensions[0];
+    int height = dimensions[1];
+    int channels = dimensions[2];
+    int newWidth = width * upscale_factor;
+    int newHeight = height * upscale_factor;
+    int sourceRowSize = width * channels;
+    int newRowSize = newWidth * channels;
+
+    // Every rank produces one band of output rows. It owns the source rows its band is centred on and gets
+    // the stencil rows beyond them from its neighbours, so a halo may not reach past the neighbouring band.
+    // The counts and displacements are in rows of the images on root
+    int outBegin, outEnd, srcBegin, srcEnd, haloAbove, haloBelow;
+    outputBand(newHeight, size, rank, &outBegin, &outEnd);
+    sourceBand(height, newHeight, size, rank, &srcBegin, &srcEnd);
+    sourceHalo(height, newHeight, size, rank, &haloAbove, &haloBelow);
+    int* sourceCounts = malloc(size * sizeof(int));
+    int* sourceDispls = malloc(size * sizeof(int));
+    int* outputCounts = malloc(size * sizeof(int));
+    int* outputDispls = malloc(size * sizeof(int));
+    for (int r = 0; r < size; r++) {
+        int begin, end;
+        sourceBand(height, newHeight, size, r, &begin, &end);
+        sourceCounts[r] = end - begin;
+        sourceDispls[r] = begin;
+        outputBand(newHeight, size, r, &begin, &end);
+        outputCounts[r] = end - begin;
+        outputDispls[r] = begin;
+    }
+    int valid = 1;
+    for (int r = 0; r < size; r++) {
+        int above, below;
+        sourceHalo(height, newHeight, size, r, &above, &below);
+        if (outputCounts[r] == 0 || (r > 0 && above > sourceCounts[r - 1]) ||
+            (r < size - 1 && below > sourceCounts[r + 1])) {
+            valid = 0;
+        }
+    }
+    if (!valid) {
+        if (rank == 0) {
+            printf("Image of %d rows is too small for %d processes\n", height, size);
+            closeBMP(&input);
+        }
+        free(sourceCounts);
+        free(sourceDispls);
+        free(outputCounts);
+        free(outputDispls);
+        MPI_Finalize();
+        return 1;
+    }
 
-    // Calculate the part of the image each process will handle
-    int local_height = newHeight / size;
-    int extra = newHeight % size;
-    int local_start = rank * local_height + (rank < extra ? rank : extra);
-    int local_end = local_start + local_height + (rank < extra ? 1 : 0);
-    unsigned char* localData = (unsigned char*)malloc(local_height * newRowSize);
+    // Local buffers: the source band with its halos, the upscaled band with one row above and below for
+    // the convolution, and the output band
+    int localSourceRows = haloAbove + (srcEnd - srcBegin) + haloBelow;
+    int localRows = outEnd - outBegin;
+    int convAbove = outBegin > 0;
+    int convBelow = outEnd < newHeight;
+    unsigned char* localSource = malloc((size_t)localSourceRows * sourceRowSize);
+    unsigned char* localUpscaled = calloc((size_t)(convAbove + localRows + convBelow), newRowSize);
+    unsigned char* localOutput = calloc((size_t)localRows, newRowSize);
+    if (!localSource || !localUpscaled || !localOutput) {
+        printf("Failed to allocate memory for image data\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
 
-    // Scatter the input data
-    MPI_Scatter(inputData, local_height * newRowSize, MPI_UNSIGNED_CHAR, localData, local_height * newRowSize, MPI_UNSIGNED_CHAR, 0, MPI_COMM_WORLD);
+    // Root creates the output file at its final size and gathers the bands straight into its mapping. The row
+    // types step through the padded, possibly bottom-up rows of the files; they only matter on root
+    if (rank == 0 && createBMP(argv[2], newWidth, newHeight, &input, &output) != 0)
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    MPI_Datatype sourceRow = createRowType(sourceRowSize, rank == 0 ? input.view.stride : sourceRowSize);
+    MPI_Datatype outputRow = createRowType(newRowSize, rank == 0 ? output.view.stride : newRowSize);
 
     double start_time = MPI_Wtime();
-    for (int y = local_start; y < local_end; y++) {
-        for (int x = 0; x < newWidth; x++) {
-            int oldX = x / upscale_factor;
-            int oldY = y / upscale_factor;
-            int oldIndex = (oldY * infoHeader.width + oldX) * 3;
-            int newIndex = (y * newWidth + x) * 3;
-            outputData[newIndex + 0] = localData[oldIndex + 0];
-            outputData[newIndex + 1] = localData[oldIndex + 1];
-            outputData[newIndex + 2] = localData[oldIndex + 2];
-        }
+
+    // Scatter the owned source rows, then trade the bicubic halos with the neighbours: the last rows of
+    // a band go down to the next rank and its first rows come back up
+    unsigned char* owned = localSource + (size_t)haloAbove * sourceRowSize;
+    MPI_Scatterv(rank == 0 ? input.view.data : NULL, sourceCounts, sourceDispls, sourceRow, owned,
+                 sourceCounts[rank] * sourceRowSize, MPI_UNSIGNED_CHAR, 0, MPI_COMM_WORLD);
+    int up = rank > 0 ? rank - 1 : MPI_PROC_NULL;
+    int down = rank < size - 1 ? rank + 1 : MPI_PROC_NULL;
+    int downAbove = 0, upBelow = 0, unused;
+    if (down != MPI_PROC_NULL)
+        sourceHalo(height, newHeight, size, down, &downAbove, &unused);
+    if (up != MPI_PROC_NULL)
+        sourceHalo(height, newHeight, size, up, &unused, &upBelow);
+    MPI_Sendrecv(owned + (size_t)(srcEnd - srcBegin - downAbove) * sourceRowSize, downAbove * sourceRowSize,
+                 MPI_UNSIGNED_CHAR, down, 0, localSource, haloAbove * sourceRowSize, MPI_UNSIGNED_CHAR, up, 0,
+                 MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    MPI_Sendrecv(owned, upBelow * sourceRowSize, MPI_UNSIGNED_CHAR, up, 1,
+                 owned + (size_t)(srcEnd - srcBegin) * sourceRowSize, haloBelow * sourceRowSize, MPI_UNSIGNED_CHAR,
+                 down, 1, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+
+    // Upscale the own output rows, then trade the boundary rows the convolution reads across bands
+    unsigned char* upscaled = localUpscaled + (size_t)convAbove * newRowSize;
+    if (bicubicInterpolateRows(localSource, sourceRowSize, upscaled, newRowSize, width, height, channels, newWidth,
+                               newHeight, outBegin, outEnd, srcBegin - haloAbove) != 0) {
+        printf("Failed to allocate memory for the interpolation tables\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    MPI_Sendrecv(upscaled + (size_t)(localRows - 1) * newRowSize, convBelow ? newRowSize : 0, MPI_UNSIGNED_CHAR, down, 2,
+                 localUpscaled, convAbove ? newRowSize : 0, MPI_UNSIGNED_CHAR, up, 2, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    MPI_Sendrecv(upscaled, convAbove ? newRowSize : 0, MPI_UNSIGNED_CHAR, up, 3,
+                 upscaled + (size_t)localRows * newRowSize, convBelow ? newRowSize : 0, MPI_UNSIGNED_CHAR, down, 3,
+                 MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+
+    // Edge detection on the band, with the same kernel as upscale_omp
+    ConvolutionKernel edgeKernel;
+    createNamedConvolutionKernel(&edgeKernel, "edge");
+    if (convolveImageRows(localUpscaled, newRowSize, localOutput, newRowSize, newWidth, newHeight, channels, &edgeKernel,
+                          outBegin, outEnd, outBegin - convAbove) != 0) {
+        printf("Failed to allocate memory for the convolution\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
     }
-    double end_time = MPI_Wtime();
 
-    MPI_Gather(localData, local_height * newRowSize, MPI_UNSIGNED_CHAR, outputData, local_height * newRowSize, MPI_UNSIGNED_CHAR, 0, MPI_COMM_WORLD);
+    // Collect the bands on root
+    MPI_Gatherv(localOutput, outputCounts[rank] * newRowSize, MPI_UNSIGNED_CHAR, rank == 0 ? output.view.data : NULL,
+                outputCounts, outputDispls, outputRow, 0, MPI_COMM_WORLD);
+    double end_time = MPI_Wtime();
 
     if (rank == 0) {
-        infoHeader.width = newWidth;
-        infoHeader.height = newHeight;
-        infoHeader.imageSize = newImageSize;
-        saveBMP(argv[2], &header, &infoHeader, outputData);
+        closeBMP(&input);
+        if (closeBMP(&output) != 0) {
+            printf("Failed to save image\n");
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
         printf("Processing time with MPI: %f seconds\n", end_time - start_time);
     }
 
-    free(inputData);
-    free(outputData);
-    free(localData);
+    MPI_Type_free(&sourceRow);
+    MPI_Type_free(&outputRow);
+    free(localSource);
+    free(localUpscaled);
+    free(localOutput);
+    free(sourceCounts);
+    free(sourceDispls);
+    free(outputCounts);
+    free(outputDispls);
     MPI_Finalize();
     return 0;
 }
@@ -1,218 +1,103 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include <omp.h>
+#include "bmp_io.h"
+#include "upscale_kernels.h"
 
-#pragma pack(push, 1)
-typedef struct
-{
-    unsigned short type;
-    unsigned int size;
-    unsigned short reserved1, reserved2;
-    unsigned int offset;
-} BMPHeader;
-
-typedef struct
-{
-    unsigned int size;
-    int width, height;
-    unsigned short planes;
-    unsigned short bitCount;
-    unsigned int compression;
-    unsigned int imageSize;
-    int xPelsPerMeter, yPelsPerMeter;
-    unsigned int clrUsed, clrImportant;
-} BMPInfoHeader;
-#pragma pack(pop)
-
-unsigned char *loadBMP(const char *filename, BMPHeader *header, BMPInfoHeader *infoHeader)
-{
-    FILE *file = fopen(filename, "rb");
-    if (!file)
-        return NULL;
-    fread(header, sizeof(BMPHeader), 1, file);
-    fread(infoHeader, sizeof(BMPInfoHeader), 1, file);
-    if (header->type != 0x4D42)
-    {
-        fclose(file);
-        return NULL;
-    }
-    unsigned char *data = (unsigned char *)malloc(infoHeader->imageSize);
-    fseek(file, header->offset, SEEK_SET);
-    fread(data, infoHeader->imageSize, 1, file);
-    fclose(file);
-    return data;
-}
-
-void saveBMP(const char *filename, BMPHeader *header, BMPInfoHeader *infoHeader, unsigned char *data)
-{
-    FILE *file = fopen(filename, "wb");
-    fwrite(header, sizeof(BMPHeader), 1, file);
-    fwrite(infoHeader, sizeof(BMPInfoHeader), 1, file);
-    fseek(file, header->offset, SEEK_SET);
-    fwrite(data, infoHeader->imageSize, 1, file);
-    fclose(file);
-}
-
-// int clamp(double x, int minVal, int maxVal) {
-//     return (int)(x < minVal ? minVal : (x > maxVal ? maxVal : x));
-// }
-
-int max(int a, int b) {
-    return (a > b) ? a : b;
-}
-
-int min(int a, int b) {
-    return (a < b) ? a : b;
-}
-
-double cubicInterpolate(double p[4], double x) {
-    return p[1] + 0.5 * x * (p[2] - p[0] + x * (2.0 * p[0] - 5.0 * p[1] + 4.0 * p[2] - p[3] + x * (3.0 * (p[1] - p[2]) + p[3] - p[0])));
-}
-
-double interpolate(double arr[4], double x) {
-    double vals[4] = {
-        cubicInterpolate(arr, x),
-        cubicInterpolate(arr + 1, x),
-        cubicInterpolate(arr + 2, x),
-        cubicInterpolate(arr + 3, x)
-    };
-    return cubicInterpolate(vals, x);
-}
-
-double cubicHermite(double A, double B, double C, double D, double t) {
-    double a = -A/2.0 + (3.0*B)/2.0 - (3.0*C)/2.0 + D/2.0;
-    double b = A - (5.0*B)/2.0 + 2.0*C - D / 2.0;
-    double c = -A/2.0 + C/2.0;
-    double d = B;
-
-    return a*t*t*t + b*t*t + c*t + d;
-}
-int clamp(double x, int minVal, int maxVal) {
-    return (int)(x < minVal ? minVal : (x > maxVal ? maxVal : x));
-}
-
-void bicubicInterpolate(const unsigned char* input, unsigned char* output, int width, int height, int channels, int newWidth, int newHeight) {
-    double x_ratio = ((double)(width-1))/newWidth;
-    double y_ratio = ((double)(height-1))/newHeight;
-    double px, py; 
-    for (int i = 0; i < newHeight; i++) {
-        for (int j = 0; j < newWidth; j++) {
-            px = x_ratio * j;
-            py = y_ratio * i;
-            int x = (int)px;
-            int y = (int)py;
-            double x_diff = px - x;
-            double y_diff = py - y;
-
-            for (int k = 0; k < channels; k++) {
-                double intensities[4][4] = {0}; // Matrix to hold nearby intensities
-
-                // Gather intensities from the 4x4 neighborhood
-                for (int m = -1; m <= 2; m++) {
-                    for (int n = -1; n <= 2; n++) {
-                        int ix = min(max(x + n, 0), width - 1);
-                        int iy = min(max(y + m, 0), height - 1);
-                        intensities[m+1][n+1] = input[(iy * width + ix) * channels + k];
-                    }
-                }
-
-                // Interpolate rows
-                double col[4] = {0};
-                for (int l = 0; l < 4; l++) {
-                    col[l] = cubicHermite(intensities[l][0], intensities[l][1], intensities[l][2], intensities[l][3], x_diff);
-                }
-
-                // Interpolate column
-                double value = cubicHermite(col[0], col[1], col[2], col[3], y_diff);
-                output[(i * newWidth + j) * channels + k] = (unsigned char)clamp(value, 0, 255);
-            }
-        }
-    }
-}
-
-
-void applyConvolution(const unsigned char *input, unsigned char *output, int width, int height, const int kernel[3][3], int kernelDiv)
+int main(int argc, char *argv[])
 {
-#pragma omp parallel for collapse(2)
-    for (int y = 1; y < height - 1; y++)
+    // The convolution applied to the upscaled image, edge detection unless --kernel names another, and the
+    // output rows processed per strip (0: the whole image in one strip)
+    ConvolutionKernel kernel;
+    const char *kernelName = "edge";
+    int stripRows = 0;
+    int badOption = 0;
+    for (int i = 4; i < argc; i++)
     {
-        for (int x = 1; x < width - 1; x++)
-        {
-            int sum = 0;
-            for (int ky = -1; ky <= 1; ky++)
-            {
-                for (int kx = -1; kx <= 1; kx++)
-                {
-                    int idx = (y + ky) * width + (x + kx);
-                    sum += input[idx] * kernel[ky + 1][kx + 1];
-                }
-            }
-            output[y * width + x] = (unsigned char)max(0, min(255, sum / kernelDiv));
-        }
+        if (strncmp(argv[i], "--kernel=", 9) == 0)
+            kernelName = argv[i] + 9;
+        else if (strncmp(argv[i], "--strip-rows=", 13) == 0 && atoi(argv[i] + 13) >= 0)
+            stripRows = atoi(argv[i] + 13);
+        else
+            badOption = 1;
     }
-}
-
-int main(int argc, char *argv[])
-{
-    if (argc != 4)
+    if (argc < 4 || badOption || createNamedConvolutionKernel(&kernel, kernelName) != 0)
     {
-        printf("Usage: %s <input.bmp> <output.bmp> <num_threads>\n", argv[0]);
+        printf("Usage: %s <input.bmp> <output.bmp> <num_threads> [--kernel=edge|gauss3|gauss5|gauss7|box5] "
+               "[--strip-rows=<n>]\n", argv[0]);
         return 1;
     }
 
     int num_threads = atoi(argv[3]);
+    if (num_threads > 0)
+        omp_set_num_threads(num_threads);
 
-    BMPHeader header;
-    BMPInfoHeader infoHeader;
-    unsigned char *inputData = loadBMP(argv[1], &header, &infoHeader);
-    if (!inputData)
+    // The input is read in place from the mapped file and the output rows go straight into the mapped output file
+    BMPImage input, output;
+    if (openBMP(argv[1], &input) != 0)
     {
         printf("Failed to load image\n");
         return 1;
     }
-
-    int newWidth = infoHeader.width * 2; // Upscale factor of 2
-    int newHeight = infoHeader.height * 2;
-    unsigned char *tempData = (unsigned char *)calloc(newWidth * newHeight, infoHeader.bitCount / 8);
-    unsigned char *outputData = (unsigned char *)calloc(newWidth * newHeight, infoHeader.bitCount / 8);
-
-    if (tempData == NULL || outputData == NULL)
+    const ImageView *source = &input.view;
+    int newWidth = source->width * 2; // Upscale factor of 2
+    int newHeight = source->height * 2;
+    if (createBMP(argv[2], newWidth, newHeight, &input, &output) != 0)
     {
-        fprintf(stderr, "Failed to allocate memory for image data\n");
-        free(inputData);
-        if (tempData != NULL)
-            free(tempData);
-        if (outputData != NULL)
-            free(outputData);
+        closeBMP(&input);
         return 1;
     }
+    const ImageView *target = &output.view;
+    if (stripRows == 0)
+        stripRows = newHeight;
+
+    // Upscaling and convolution run fused, row strip by row strip, so the upscaled image is never stored in full.
+    // The pages of a strip are faulted in before it and its output rows and the source rows no later strip
+    // reads are released after it
+    double start_time = omp_get_wtime();
+    int released = 0;
+    for (int stripBegin = 0; stripBegin < newHeight; stripBegin += stripRows)
+    {
+        int stripEnd = min(stripBegin + stripRows, newHeight);
+        int first, last;
+        sourceRowsOfBand(source->height, newHeight, max(stripBegin - kernel.radius, 0),
+                         min(stripEnd + kernel.radius, newHeight), &first, &last);
+        prepareBMPRows(&input, first, last);
+        prepareBMPRows(&output, stripBegin, stripEnd);
+        if (upscaleAndConvolveRows(source->data, source->stride, target->data, target->stride, source->width,
+                                   source->height, source->channels, newWidth, newHeight, &kernel, stripBegin,
+                                   stripEnd) != 0)
+        {
+            fprintf(stderr, "Failed to allocate memory for the interpolation tables\n");
+            closeBMP(&input);
+            closeBMP(&output);
+            return 1;
+        }
+        if (stripEnd < newHeight)
+        {
+            sourceRowsOfBand(source->height, newHeight, max(stripEnd - kernel.radius, 0), stripEnd, &first, &last);
+            releaseBMPRows(&input, released, first);
+            releaseBMPRows(&output, stripBegin, stripEnd);
+            released = max(released, first);
+        }
+    }
+    double end_time = omp_get_wtime();
 
-    bicubicInterpolate(inputData, tempData, infoHeader.width, infoHeader.height , 3, newWidth, newHeight);
-
-    // Uncomment the following section if you want to apply edge detection
-    
-    int edgeKernel[3][3] = {
-        {-1, -1, -1},
-        {-1, 8, -1},
-        {-1, -1, -1}};
-    int kernelDiv = 1;
-    applyConvolution(tempData, outputData, newWidth, newHeight, edgeKernel, kernelDiv);
-    
-
-    infoHeader.width = newWidth;
-    infoHeader.height = newHeight;
-    infoHeader.imageSize = newWidth * newHeight * (infoHeader.bitCount / 8);
-
-    saveBMP(argv[2], &header, &infoHeader, outputData);
+    closeBMP(&input);
+    if (closeBMP(&output) != 0)
+    {
+        printf("Failed to save image\n");
+        return 1;
+    }
 
-    free(inputData);
-    free(tempData);
-    free(outputData);
+    printf("Processing time with OpenMP: %f seconds\n", end_time - start_time);
     return 0;
 }
 
 
+
 // #include <stdio.h>
 // #include <stdlib.h>
 // #include <omp.h>
@@ -709,7 +594,7 @@ int main(int argc, char *argv[])
 //         {-1, 8, -1},
 //         {-1, -1, -1}};
 //     int kernelDiv = 1; // Division factor for kernel normalization, if needed
-//     applyConvolution(tempData, outputData, newWidth, newHeight, edgeKernel, kernelDiv);
+//     applyConvolution(tempData, outputData, newWidth, newHeight, 3, edgeKernel, kernelDiv);
 
 //     double end_time = omp_get_wtime();
 
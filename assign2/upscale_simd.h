@@ -0,0 +1,223 @@
+/*
+ * Programmer(s) : Syed Saad Ullah Hussaini, K214703 Ali Raza, K213100 Muhammad Sameed
+ * Date: 17 October 2026
+ * Desc: Fixed-point kernels of the separable bicubic upscaler (scalar, SSE4.1
+ *       and AVX2) for 8-bit images, with the best one picked at runtime from
+ *       CPUID. The weights are 16-bit Q14 numbers; the horizontal pass keeps
+ *       its rows as 16-bit Q6 numbers, and the vertical pass rounds, shifts and
+ *       saturates to 0..255 in registers, so no pixel ever goes through double.
+ *       The SIMD horizontal kernels work on interleaved RGB (3 channels); other
+ *       channel counts use the scalar horizontal pass.
+ *       Set UPSCALE_SIMD=double|scalar|sse41|avx2 to force a particular path,
+ *       double being the floating point reference in upscale_kernels.h.
+ */
+
+#ifndef UPSCALE_SIMD_H
+#define UPSCALE_SIMD_H
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define UPSCALE_X86 1
+#endif
+
+#define BICUBIC_WEIGHT_BITS 14   // Fraction bits of the fixed-point weights; the four weights of a tap sum to 1 << 14
+#define BICUBIC_FILTERED_BITS 6  // Fraction bits of the horizontally filtered rows (-32..287 fits 16 bits)
+#define BICUBIC_ROW_SHIFT (BICUBIC_WEIGHT_BITS - BICUBIC_FILTERED_BITS)
+#define BICUBIC_COLUMN_SHIFT (BICUBIC_WEIGHT_BITS + BICUBIC_FILTERED_BITS)
+
+// A row kernel filters one source row horizontally: filtered[j * channels + c] is the four-tap sum of output
+// column j, whose source columns and Q14 weights are index[4 * j ..] and weight[4 * j ..]
+typedef void (*BicubicRowKernel)(const unsigned char* row, short* filtered, const int* index, const short* weight,
+                                 int width, int newWidth, int channels);
+
+// A column kernel sums four filtered rows into count output bytes
+typedef void (*BicubicColumnKernel)(const short* const rows[4], const short weight[4], unsigned char* out, size_t count);
+
+// Function to filter output columns [columnBegin, columnEnd) of a row, portable
+static inline void bicubicRowRange(const unsigned char* row, short* filtered, const int* index, const short* weight,
+                                   int channels, int columnBegin, int columnEnd) {
+    for (int j = columnBegin; j < columnEnd; j++) {
+        const int* taps = index + 4 * (size_t)j;
+        const short* w = weight + 4 * (size_t)j;
+        for (int k = 0; k < channels; k++) {
+            int sum = w[0] * row[taps[0] * channels + k] + w[1] * row[taps[1] * channels + k] +
+                      w[2] * row[taps[2] * channels + k] + w[3] * row[taps[3] * channels + k];
+            filtered[(size_t)j * channels + k] = (short)((sum + (1 << (BICUBIC_ROW_SHIFT - 1))) >> BICUBIC_ROW_SHIFT);
+        }
+    }
+}
+
+static inline void bicubicRowScalar(const unsigned char* row, short* filtered, const int* index, const short* weight,
+                                    int width, int newWidth, int channels) {
+    (void)width;
+    bicubicRowRange(row, filtered, index, weight, channels, 0, newWidth);
+}
+
+// Function to sum output bytes [begin, count) of four filtered rows, portable
+static inline void bicubicColumnRange(const short* const rows[4], const short weight[4], unsigned char* out, size_t begin,
+                                      size_t count) {
+    for (size_t x = begin; x < count; x++) {
+        int sum = weight[0] * rows[0][x] + weight[1] * rows[1][x] + weight[2] * rows[2][x] + weight[3] * rows[3][x];
+        sum = (sum + (1 << (BICUBIC_COLUMN_SHIFT - 1))) >> BICUBIC_COLUMN_SHIFT;
+        out[x] = (unsigned char)(sum < 0 ? 0 : (sum > 255 ? 255 : sum));
+    }
+}
+
+static inline void bicubicColumnScalar(const short* const rows[4], const short weight[4], unsigned char* out, size_t count) {
+    bicubicColumnRange(rows, weight, out, 0, count);
+}
+
+#ifdef UPSCALE_X86
+
+// Function to load the 4 bytes of a pixel and the byte after it
+static inline int loadPixel(const unsigned char* p) {
+    int value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+// Function to pack two Q14 weights into the 32-bit pairs _mm_madd_epi16 multiplies with
+static inline int weightPair(short a, short b) {
+    return (int)(unsigned short)a | ((int)(unsigned short)b << 16);
+}
+
+// One output pixel per step: the R, G and B bytes of two taps are interleaved into 16-bit pairs, so two
+// multiply-adds give the three channel sums. A pixel load reads one byte past the pixel, so the columns
+// that reach the last source pixel are left to the portable loop
+__attribute__((target("sse4.1")))
+static void bicubicRowSse41(const unsigned char* row, short* filtered, const int* index, const short* weight, int width,
+                            int newWidth, int channels) {
+    if (channels != 3) {
+        bicubicRowRange(row, filtered, index, weight, channels, 0, newWidth);
+        return;
+    }
+    const __m128i round = _mm_set1_epi32(1 << (BICUBIC_ROW_SHIFT - 1));
+    int j = 0;
+    for (; j < newWidth && index[4 * (size_t)j + 3] < width - 1; j++) {
+        const int* taps = index + 4 * (size_t)j;
+        const short* w = weight + 4 * (size_t)j;
+        __m128i p0 = _mm_cvtsi32_si128(loadPixel(row + 3 * taps[0]));
+        __m128i p1 = _mm_cvtsi32_si128(loadPixel(row + 3 * taps[1]));
+        __m128i p2 = _mm_cvtsi32_si128(loadPixel(row + 3 * taps[2]));
+        __m128i p3 = _mm_cvtsi32_si128(loadPixel(row + 3 * taps[3]));
+        __m128i a = _mm_cvtepu8_epi16(_mm_unpacklo_epi8(p0, p1));
+        __m128i b = _mm_cvtepu8_epi16(_mm_unpacklo_epi8(p2, p3));
+        __m128i sum = _mm_add_epi32(_mm_madd_epi16(a, _mm_set1_epi32(weightPair(w[0], w[1]))),
+                                    _mm_madd_epi16(b, _mm_set1_epi32(weightPair(w[2], w[3]))));
+        sum = _mm_srai_epi32(_mm_add_epi32(sum, round), BICUBIC_ROW_SHIFT);
+        // Stores four values; the fourth is overwritten by the next pixel, at the latest by the portable loop
+        _mm_storel_epi64((__m128i*)(filtered + 3 * (size_t)j), _mm_packs_epi32(sum, sum));
+    }
+    bicubicRowRange(row, filtered, index, weight, channels, j, newWidth);
+}
+
+__attribute__((target("sse4.1")))
+static void bicubicColumnSse41(const short* const rows[4], const short weight[4], unsigned char* out, size_t count) {
+    const __m128i w01 = _mm_set1_epi32(weightPair(weight[0], weight[1]));
+    const __m128i w23 = _mm_set1_epi32(weightPair(weight[2], weight[3]));
+    const __m128i round = _mm_set1_epi32(1 << (BICUBIC_COLUMN_SHIFT - 1));
+    size_t x = 0;
+    for (; x + 16 <= count; x += 16) {
+        __m128i packed[2];
+        for (int h = 0; h < 2; h++) {
+            __m128i r0 = _mm_loadu_si128((const __m128i*)(rows[0] + x + 8 * h));
+            __m128i r1 = _mm_loadu_si128((const __m128i*)(rows[1] + x + 8 * h));
+            __m128i r2 = _mm_loadu_si128((const __m128i*)(rows[2] + x + 8 * h));
+            __m128i r3 = _mm_loadu_si128((const __m128i*)(rows[3] + x + 8 * h));
+            __m128i lo = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(r0, r1), w01),
+                                       _mm_madd_epi16(_mm_unpacklo_epi16(r2, r3), w23));
+            __m128i hi = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(r0, r1), w01),
+                                       _mm_madd_epi16(_mm_unpackhi_epi16(r2, r3), w23));
+            lo = _mm_srai_epi32(_mm_add_epi32(lo, round), BICUBIC_COLUMN_SHIFT);
+            hi = _mm_srai_epi32(_mm_add_epi32(hi, round), BICUBIC_COLUMN_SHIFT);
+            packed[h] = _mm_packs_epi32(lo, hi);
+        }
+        _mm_storeu_si128((__m128i*)(out + x), _mm_packus_epi16(packed[0], packed[1]));
+    }
+    bicubicColumnRange(rows, weight, out, x, count);
+}
+
+// The same sums on 16 values per register; the unpacks and packs work inside 128-bit lanes, so the final
+// permute puts the two lanes of each half back in order
+__attribute__((target("avx2")))
+static void bicubicColumnAvx2(const short* const rows[4], const short weight[4], unsigned char* out, size_t count) {
+    const __m256i w01 = _mm256_set1_epi32(weightPair(weight[0], weight[1]));
+    const __m256i w23 = _mm256_set1_epi32(weightPair(weight[2], weight[3]));
+    const __m256i round = _mm256_set1_epi32(1 << (BICUBIC_COLUMN_SHIFT - 1));
+    size_t x = 0;
+    for (; x + 32 <= count; x += 32) {
+        __m256i packed[2];
+        for (int h = 0; h < 2; h++) {
+            __m256i r0 = _mm256_loadu_si256((const __m256i*)(rows[0] + x + 16 * h));
+            __m256i r1 = _mm256_loadu_si256((const __m256i*)(rows[1] + x + 16 * h));
+            __m256i r2 = _mm256_loadu_si256((const __m256i*)(rows[2] + x + 16 * h));
+            __m256i r3 = _mm256_loadu_si256((const __m256i*)(rows[3] + x + 16 * h));
+            __m256i lo = _mm256_add_epi32(_mm256_madd_epi16(_mm256_unpacklo_epi16(r0, r1), w01),
+                                          _mm256_madd_epi16(_mm256_unpacklo_epi16(r2, r3), w23));
+            __m256i hi = _mm256_add_epi32(_mm256_madd_epi16(_mm256_unpackhi_epi16(r0, r1), w01),
+                                          _mm256_madd_epi16(_mm256_unpackhi_epi16(r2, r3), w23));
+            lo = _mm256_srai_epi32(_mm256_add_epi32(lo, round), BICUBIC_COLUMN_SHIFT);
+            hi = _mm256_srai_epi32(_mm256_add_epi32(hi, round), BICUBIC_COLUMN_SHIFT);
+            packed[h] = _mm256_packs_epi32(lo, hi);
+        }
+        __m256i bytes = _mm256_packus_epi16(packed[0], packed[1]);
+        _mm256_storeu_si256((__m256i*)(out + x), _mm256_permute4x64_epi64(bytes, 0xD8));
+    }
+    bicubicColumnRange(rows, weight, out, x, count);
+}
+
+#endif // UPSCALE_X86
+
+typedef struct {
+    const char* name;
+    BicubicRowKernel row;       // NULL for the double precision path
+    BicubicColumnKernel column;
+} BicubicKernelInfo;
+
+// Function to pick the widest kernel the CPU supports (or the one named in UPSCALE_SIMD)
+static inline const BicubicKernelInfo* selectBicubicKernel(void) {
+    static const BicubicKernelInfo kernels[] = {
+#ifdef UPSCALE_X86
+        {"avx2", bicubicRowSse41, bicubicColumnAvx2},
+        {"sse41", bicubicRowSse41, bicubicColumnSse41},
+#endif
+        {"scalar", bicubicRowScalar, bicubicColumnScalar},
+        {"double", NULL, NULL},
+    };
+    static const BicubicKernelInfo* selected = NULL;
+    if (selected != NULL) {
+        return selected;
+    }
+
+    int count = sizeof(kernels) / sizeof(kernels[0]);
+    int supported[sizeof(kernels) / sizeof(kernels[0])];
+    for (int k = 0; k < count; k++) {
+        supported[k] = 1;
+    }
+#ifdef UPSCALE_X86
+    __builtin_cpu_init();
+    supported[0] = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("sse4.1");
+    supported[1] = __builtin_cpu_supports("sse4.1");
+#endif
+
+    const char* forced = getenv("UPSCALE_SIMD");
+    for (int k = 0; k < count && forced != NULL; k++) {
+        if (strcmp(forced, kernels[k].name) == 0 && supported[k]) {
+            selected = &kernels[k];
+            return selected;
+        }
+    }
+    for (int k = 0; k < count; k++) {
+        if (supported[k]) {
+            selected = &kernels[k];
+            break;
+        }
+    }
+    return selected;
+}
+
+#endif // UPSCALE_SIMD_H
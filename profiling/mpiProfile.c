@@ -0,0 +1,632 @@
+/*
+ * Programmer(s) : Syed Saad Ullah Hussaini, K214703 Ali Raza, K213100 Muhammad Sameed
+ * Date: 17 October 2026
+ * Desc: PMPI profiling layer for the MPI programs of this repository (assign1
+ *       mXv_mpi_task_4 and mXv_tiled_mpi_task_6, assign2 upscale_mpi). Every
+ *       wrapped call counts its calls, the payload bytes this rank sends plus
+ *       receives and the time spent in it, then forwards to the PMPI_ entry
+ *       point. At MPI_Finalize the counters of all ranks are reduced and rank 0
+ *       prints one report on standard error: per call the totals, the mean and
+ *       slowest rank time and their ratio (the imbalance), and per program the
+ *       time outside MPI (compute).
+ *
+ *       Build:  mpicc -O2 -Wall -shared -fPIC profiling/mpiProfile.c -o libmpiprofile.so
+ *       Use:    mpirun -np 4 -x LD_PRELOAD=$PWD/libmpiprofile.so ./mXv_mpi_task_4 4096 4096
+ *               or link it in front of the MPI library: mpicc ... -L. -lmpiprofile
+ *
+ *       MPI_PROFILE_SYNC=1   puts a barrier in front of every blocking collective and books its
+ *                            time as wait, which separates waiting for late ranks from the transfer
+ *       MPI_PROFILE_RANKS=1  adds one line per rank with its compute, MPI and wait time
+ *
+ *       The persistent collectives of MPI-4 (MPI_Allreduce_init, MPI_Allgatherv_init,
+ *       MPI_Reduce_scatter_init) are remembered per request, so every MPI_Start or
+ *       MPI_Startall of one counts as a call of that collective, with its bytes, and
+ *       the time of the MPI_Start and of the MPI_Wait or MPI_Waitall that completes it
+ *       is booked there rather than under MPI_Start and MPI_Wait. The shared memory
+ *       window synchronisation (MPI_Win_sync, MPI_Win_lock_all, MPI_Win_unlock_all)
+ *       has rows of its own.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mpi.h>
+
+typedef enum {
+    PROFILE_BCAST,
+    PROFILE_SCATTER,
+    PROFILE_SCATTERV,
+    PROFILE_GATHER,
+    PROFILE_GATHERV,
+    PROFILE_ALLGATHER,
+    PROFILE_ALLGATHERV,
+    PROFILE_REDUCE,
+    PROFILE_ALLREDUCE,
+    PROFILE_REDUCE_SCATTER,
+    PROFILE_ALLTOALLV,
+    PROFILE_BARRIER,
+    PROFILE_IBCAST,
+    PROFILE_ISCATTERV,
+    PROFILE_IGATHERV,
+    PROFILE_SEND,
+    PROFILE_RECV,
+    PROFILE_ISEND,
+    PROFILE_IRECV,
+    PROFILE_SENDRECV,
+    PROFILE_WAIT,
+    PROFILE_WAITALL,
+    PROFILE_FILE_READ_AT_ALL,
+    PROFILE_FILE_WRITE_AT_ALL,
+    PROFILE_ALLREDUCE_INIT,
+    PROFILE_ALLGATHERV_INIT,
+    PROFILE_REDUCE_SCATTER_INIT,
+    PROFILE_START,
+    PROFILE_WIN_SYNC,
+    PROFILE_WIN_LOCK_ALL,
+    PROFILE_WIN_UNLOCK_ALL,
+    PROFILE_CALLS
+} ProfiledCall;
+
+static const char* const profiledNames[PROFILE_CALLS] = {
+    "MPI_Bcast", "MPI_Scatter", "MPI_Scatterv", "MPI_Gather", "MPI_Gatherv", "MPI_Allgather", "MPI_Allgatherv",
+    "MPI_Reduce", "MPI_Allreduce", "MPI_Reduce_scatter", "MPI_Alltoallv", "MPI_Barrier", "MPI_Ibcast",
+    "MPI_Iscatterv", "MPI_Igatherv", "MPI_Send", "MPI_Recv", "MPI_Isend", "MPI_Irecv", "MPI_Sendrecv", "MPI_Wait",
+    "MPI_Waitall", "MPI_File_read_at_all", "MPI_File_write_at_all", "MPI_Allreduce_init", "MPI_Allgatherv_init",
+    "MPI_Reduce_scatter_init", "MPI_Start", "MPI_Win_sync", "MPI_Win_lock_all", "MPI_Win_unlock_all"};
+
+// Counters of one call on this rank; all doubles so they reduce as one MPI_DOUBLE array
+typedef struct {
+    double calls;
+    double bytes;   // Payload sent plus received by this rank (posted counts for receives)
+    double seconds; // Time inside the call, without the MPI_PROFILE_SYNC barrier
+    double wait;    // Time in the MPI_PROFILE_SYNC barrier in front of the call
+} CallStats;
+
+#define STATS_FIELDS 4
+
+static CallStats stats[PROFILE_CALLS];
+static double startTime;
+static int syncCollectives;
+static int perRankReport;
+
+// A persistent collective request: the call and bytes it carries, booked at every start
+typedef struct {
+    MPI_Request request;
+    ProfiledCall call;
+    double bytes;
+    MPI_Comm comm;
+    int active; // Started and not completed yet
+} PersistentRequest;
+
+#define MAX_PERSISTENT 64
+
+static PersistentRequest persistent[MAX_PERSISTENT];
+static int persistentCount;
+
+// Function to read a 0/1 switch from the environment
+static int environmentSwitch(const char* name) {
+    const char* value = getenv(name);
+    return value != NULL && value[0] != '\0' && strcmp(value, "0") != 0;
+}
+
+// Function to start profiling once MPI is up
+static void startProfile(void) {
+    memset(stats, 0, sizeof(stats));
+    syncCollectives = environmentSwitch("MPI_PROFILE_SYNC");
+    perRankReport = environmentSwitch("MPI_PROFILE_RANKS");
+    startTime = PMPI_Wtime();
+}
+
+// Function to get the bytes of count elements of type
+static double typeBytes(MPI_Datatype type, double count) {
+    int size;
+    PMPI_Type_size(type, &size);
+    return count * size;
+}
+
+// Function to get the bytes of the per-rank counts of a v-collective, summed over the ranks of comm
+static double countsBytes(MPI_Datatype type, const int* counts, MPI_Comm comm) {
+    int size;
+    PMPI_Comm_size(comm, &size);
+    double total = 0.0;
+    for (int r = 0; r < size; r++) {
+        total += counts[r];
+    }
+    return typeBytes(type, total);
+}
+
+// Function to check whether the calling rank is the root of a rooted collective
+static int isRoot(int root, MPI_Comm comm) {
+    int rank;
+    PMPI_Comm_rank(comm, &rank);
+    return rank == root;
+}
+
+// Function to wait for all ranks of comm in front of a blocking collective when MPI_PROFILE_SYNC is set;
+// the time spent here is the time this rank waited for the late ones
+static void syncBefore(ProfiledCall call, MPI_Comm comm) {
+    if (syncCollectives) {
+        double start = PMPI_Wtime();
+        PMPI_Barrier(comm);
+        stats[call].wait += PMPI_Wtime() - start;
+    }
+}
+
+// Function to book one call that started at start and moved bytes
+static void record(ProfiledCall call, double start, double bytes) {
+    stats[call].calls += 1.0;
+    stats[call].bytes += bytes;
+    stats[call].seconds += PMPI_Wtime() - start;
+}
+
+// Function to find the persistent collective a request carries, NULL for any other request
+static PersistentRequest* findPersistent(MPI_Request request) {
+    for (int i = 0; i < persistentCount; i++) {
+        if (persistent[i].request == request) {
+            return &persistent[i];
+        }
+    }
+    return NULL;
+}
+
+// Function to start one request: a persistent collective is booked as a call of its own (behind the
+// MPI_PROFILE_SYNC barrier like the blocking collectives), anything else under MPI_Start
+static int startRequest(MPI_Request* request) {
+    PersistentRequest* entry = findPersistent(*request);
+    if (entry != NULL) {
+        syncBefore(entry->call, entry->comm);
+    }
+    double start = PMPI_Wtime();
+    int error = PMPI_Start(request);
+    if (entry != NULL) {
+        record(entry->call, start, entry->bytes);
+        entry->active = 1;
+    } else {
+        record(PROFILE_START, start, 0.0);
+    }
+    return error;
+}
+
+// Function to book the time of a wait that started at start on the requests it completed: to the
+// persistent collective if they all carry the same started one, to fallback otherwise. entries holds the
+// persistent entries of the requests (NULL for the others), looked up before the wait.
+static void recordWait(PersistentRequest** entries, int count, ProfiledCall fallback, double start) {
+    ProfiledCall call = fallback;
+    for (int i = 0; i < count; i++) {
+        if (entries[i] == NULL || !entries[i]->active || (call != fallback && entries[i]->call != call)) {
+            call = fallback;
+            break;
+        }
+        call = entries[i]->call;
+    }
+    if (call == fallback) {
+        record(fallback, start, 0.0);
+    } else {
+        stats[call].seconds += PMPI_Wtime() - start;
+    }
+    for (int i = 0; i < count; i++) {
+        if (entries[i] != NULL) {
+            entries[i]->active = 0;
+        }
+    }
+}
+
+int MPI_Init(int* argc, char*** argv) {
+    int error = PMPI_Init(argc, argv);
+    startProfile();
+    return error;
+}
+
+int MPI_Init_thread(int* argc, char*** argv, int required, int* provided) {
+    int error = PMPI_Init_thread(argc, argv, required, provided);
+    startProfile();
+    return error;
+}
+
+int MPI_Bcast(void* buffer, int count, MPI_Datatype datatype, int root, MPI_Comm comm) {
+    syncBefore(PROFILE_BCAST, comm);
+    double start = PMPI_Wtime();
+    int error = PMPI_Bcast(buffer, count, datatype, root, comm);
+    record(PROFILE_BCAST, start, typeBytes(datatype, count));
+    return error;
+}
+
+int MPI_Scatter(const void* sendbuf, int sendcount, MPI_Datatype sendtype, void* recvbuf, int recvcount,
+                MPI_Datatype recvtype, int root, MPI_Comm comm) {
+    syncBefore(PROFILE_SCATTER, comm);
+    double start = PMPI_Wtime();
+    int error = PMPI_Scatter(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, root, comm);
+    double bytes = recvbuf == MPI_IN_PLACE ? 0.0 : typeBytes(recvtype, recvcount);
+    if (isRoot(root, comm)) {
+        int size;
+        PMPI_Comm_size(comm, &size);
+        bytes += typeBytes(sendtype, (double)sendcount * size);
+    }
+    record(PROFILE_SCATTER, start, bytes);
+    return error;
+}
+
+int MPI_Scatterv(const void* sendbuf, const int sendcounts[], const int displs[], MPI_Datatype sendtype, void* recvbuf,
+                 int recvcount, MPI_Datatype recvtype, int root, MPI_Comm comm) {
+    syncBefore(PROFILE_SCATTERV, comm);
+    double start = PMPI_Wtime();
+    int error = PMPI_Scatterv(sendbuf, sendcounts, displs, sendtype, recvbuf, recvcount, recvtype, root, comm);
+    double bytes = recvbuf == MPI_IN_PLACE ? 0.0 : typeBytes(recvtype, recvcount);
+    if (isRoot(root, comm)) {
+        bytes += countsBytes(sendtype, sendcounts, comm);
+    }
+    record(PROFILE_SCATTERV, start, bytes);
+    return error;
+}
+
+int MPI_Gather(const void* sendbuf, int sendcount, MPI_Datatype sendtype, void* recvbuf, int recvcount,
+               MPI_Datatype recvtype, int root, MPI_Comm comm) {
+    syncBefore(PROFILE_GATHER, comm);
+    double start = PMPI_Wtime();
+    int error = PMPI_Gather(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, root, comm);
+    double bytes = sendbuf == MPI_IN_PLACE ? 0.0 : typeBytes(sendtype, sendcount);
+    if (isRoot(root, comm)) {
+        int size;
+        PMPI_Comm_size(comm, &size);
+        bytes += typeBytes(recvtype, (double)recvcount * size);
+    }
+    record(PROFILE_GATHER, start, bytes);
+    return error;
+}
+
+int MPI_Gatherv(const void* sendbuf, int sendcount, MPI_Datatype sendtype, void* recvbuf, const int recvcounts[],
+                const int displs[], MPI_Datatype recvtype, int root, MPI_Comm comm) {
+    syncBefore(PROFILE_GATHERV, comm);
+    double start = PMPI_Wtime();
+    int error = PMPI_Gatherv(sendbuf, sendcount, sendtype, recvbuf, recvcounts, displs, recvtype, root, comm);
+    double bytes = sendbuf == MPI_IN_PLACE ? 0.0 : typeBytes(sendtype, sendcount);
+    if (isRoot(root, comm)) {
+        bytes += countsBytes(recvtype, recvcounts, comm);
+    }
+    record(PROFILE_GATHERV, start, bytes);
+    return error;
+}
+
+int MPI_Allgather(const void* sendbuf, int sendcount, MPI_Datatype sendtype, void* recvbuf, int recvcount,
+                  MPI_Datatype recvtype, MPI_Comm comm) {
+    syncBefore(PROFILE_ALLGATHER, comm);
+    double start = PMPI_Wtime();
+    int error = PMPI_Allgather(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, comm);
+    int size;
+    PMPI_Comm_size(comm, &size);
+    double bytes = (sendbuf == MPI_IN_PLACE ? 0.0 : typeBytes(sendtype, sendcount)) +
+                   typeBytes(recvtype, (double)recvcount * size);
+    record(PROFILE_ALLGATHER, start, bytes);
+    return error;
+}
+
+int MPI_Allgatherv(const void* sendbuf, int sendcount, MPI_Datatype sendtype, void* recvbuf, const int recvcounts[],
+                   const int displs[], MPI_Datatype recvtype, MPI_Comm comm) {
+    syncBefore(PROFILE_ALLGATHERV, comm);
+    double start = PMPI_Wtime();
+    int error = PMPI_Allgatherv(sendbuf, sendcount, sendtype, recvbuf, recvcounts, displs, recvtype, comm);
+    double bytes = (sendbuf == MPI_IN_PLACE ? 0.0 : typeBytes(sendtype, sendcount)) +
+                   countsBytes(recvtype, recvcounts, comm);
+    record(PROFILE_ALLGATHERV, start, bytes);
+    return error;
+}
+
+int MPI_Reduce(const void* sendbuf, void* recvbuf, int count, MPI_Datatype datatype, MPI_Op op, int root, MPI_Comm comm) {
+    syncBefore(PROFILE_REDUCE, comm);
+    double start = PMPI_Wtime();
+    int error = PMPI_Reduce(sendbuf, recvbuf, count, datatype, op, root, comm);
+    record(PROFILE_REDUCE, start, typeBytes(datatype, count));
+    return error;
+}
+
+int MPI_Allreduce(const void* sendbuf, void* recvbuf, int count, MPI_Datatype datatype, MPI_Op op, MPI_Comm comm) {
+    syncBefore(PROFILE_ALLREDUCE, comm);
+    double start = PMPI_Wtime();
+    int error = PMPI_Allreduce(sendbuf, recvbuf, count, datatype, op, comm);
+    record(PROFILE_ALLREDUCE, start, 2.0 * typeBytes(datatype, count));
+    return error;
+}
+
+int MPI_Reduce_scatter(const void* sendbuf, void* recvbuf, const int recvcounts[], MPI_Datatype datatype, MPI_Op op,
+                       MPI_Comm comm) {
+    syncBefore(PROFILE_REDUCE_SCATTER, comm);
+    double start = PMPI_Wtime();
+    int error = PMPI_Reduce_scatter(sendbuf, recvbuf, recvcounts, datatype, op, comm);
+    int rank;
+    PMPI_Comm_rank(comm, &rank);
+    record(PROFILE_REDUCE_SCATTER, start, countsBytes(datatype, recvcounts, comm) + typeBytes(datatype, recvcounts[rank]));
+    return error;
+}
+
+int MPI_Alltoallv(const void* sendbuf, const int sendcounts[], const int sdispls[], MPI_Datatype sendtype, void* recvbuf,
+                  const int recvcounts[], const int rdispls[], MPI_Datatype recvtype, MPI_Comm comm) {
+    syncBefore(PROFILE_ALLTOALLV, comm);
+    double start = PMPI_Wtime();
+    int error = PMPI_Alltoallv(sendbuf, sendcounts, sdispls, sendtype, recvbuf, recvcounts, rdispls, recvtype, comm);
+    double bytes = (sendbuf == MPI_IN_PLACE ? 0.0 : countsBytes(sendtype, sendcounts, comm)) +
+                   countsBytes(recvtype, recvcounts, comm);
+    record(PROFILE_ALLTOALLV, start, bytes);
+    return error;
+}
+
+int MPI_Barrier(MPI_Comm comm) {
+    double start = PMPI_Wtime();
+    int error = PMPI_Barrier(comm);
+    record(PROFILE_BARRIER, start, 0.0);
+    return error;
+}
+
+int MPI_Ibcast(void* buffer, int count, MPI_Datatype datatype, int root, MPI_Comm comm, MPI_Request* request) {
+    double start = PMPI_Wtime();
+    int error = PMPI_Ibcast(buffer, count, datatype, root, comm, request);
+    record(PROFILE_IBCAST, start, typeBytes(datatype, count));
+    return error;
+}
+
+int MPI_Iscatterv(const void* sendbuf, const int sendcounts[], const int displs[], MPI_Datatype sendtype, void* recvbuf,
+                  int recvcount, MPI_Datatype recvtype, int root, MPI_Comm comm, MPI_Request* request) {
+    double start = PMPI_Wtime();
+    int error = PMPI_Iscatterv(sendbuf, sendcounts, displs, sendtype, recvbuf, recvcount, recvtype, root, comm, request);
+    double bytes = recvbuf == MPI_IN_PLACE ? 0.0 : typeBytes(recvtype, recvcount);
+    if (isRoot(root, comm)) {
+        bytes += countsBytes(sendtype, sendcounts, comm);
+    }
+    record(PROFILE_ISCATTERV, start, bytes);
+    return error;
+}
+
+int MPI_Igatherv(const void* sendbuf, int sendcount, MPI_Datatype sendtype, void* recvbuf, const int recvcounts[],
+                 const int displs[], MPI_Datatype recvtype, int root, MPI_Comm comm, MPI_Request* request) {
+    double start = PMPI_Wtime();
+    int error = PMPI_Igatherv(sendbuf, sendcount, sendtype, recvbuf, recvcounts, displs, recvtype, root, comm, request);
+    double bytes = sendbuf == MPI_IN_PLACE ? 0.0 : typeBytes(sendtype, sendcount);
+    if (isRoot(root, comm)) {
+        bytes += countsBytes(recvtype, recvcounts, comm);
+    }
+    record(PROFILE_IGATHERV, start, bytes);
+    return error;
+}
+
+int MPI_Send(const void* buf, int count, MPI_Datatype datatype, int dest, int tag, MPI_Comm comm) {
+    double start = PMPI_Wtime();
+    int error = PMPI_Send(buf, count, datatype, dest, tag, comm);
+    record(PROFILE_SEND, start, typeBytes(datatype, count));
+    return error;
+}
+
+int MPI_Recv(void* buf, int count, MPI_Datatype datatype, int source, int tag, MPI_Comm comm, MPI_Status* status) {
+    double start = PMPI_Wtime();
+    int error = PMPI_Recv(buf, count, datatype, source, tag, comm, status);
+    record(PROFILE_RECV, start, typeBytes(datatype, count));
+    return error;
+}
+
+int MPI_Isend(const void* buf, int count, MPI_Datatype datatype, int dest, int tag, MPI_Comm comm, MPI_Request* request) {
+    double start = PMPI_Wtime();
+    int error = PMPI_Isend(buf, count, datatype, dest, tag, comm, request);
+    record(PROFILE_ISEND, start, typeBytes(datatype, count));
+    return error;
+}
+
+int MPI_Irecv(void* buf, int count, MPI_Datatype datatype, int source, int tag, MPI_Comm comm, MPI_Request* request) {
+    double start = PMPI_Wtime();
+    int error = PMPI_Irecv(buf, count, datatype, source, tag, comm, request);
+    record(PROFILE_IRECV, start, typeBytes(datatype, count));
+    return error;
+}
+
+int MPI_Sendrecv(const void* sendbuf, int sendcount, MPI_Datatype sendtype, int dest, int sendtag, void* recvbuf,
+                 int recvcount, MPI_Datatype recvtype, int source, int recvtag, MPI_Comm comm, MPI_Status* status) {
+    double start = PMPI_Wtime();
+    int error = PMPI_Sendrecv(sendbuf, sendcount, sendtype, dest, sendtag, recvbuf, recvcount, recvtype, source, recvtag,
+                              comm, status);
+    record(PROFILE_SENDRECV, start, typeBytes(sendtype, sendcount) + typeBytes(recvtype, recvcount));
+    return error;
+}
+
+int MPI_Wait(MPI_Request* request, MPI_Status* status) {
+    PersistentRequest* entry = findPersistent(*request);
+    double start = PMPI_Wtime();
+    int error = PMPI_Wait(request, status);
+    recordWait(&entry, 1, PROFILE_WAIT, start);
+    return error;
+}
+
+int MPI_Waitall(int count, MPI_Request requests[], MPI_Status statuses[]) {
+    // Completed requests turn into MPI_REQUEST_NULL, so they are looked up before the wait
+    PersistentRequest* entries[MAX_PERSISTENT];
+    int tracked = count <= MAX_PERSISTENT && persistentCount > 0;
+    for (int i = 0; tracked && i < count; i++) {
+        entries[i] = findPersistent(requests[i]);
+    }
+    double start = PMPI_Wtime();
+    int error = PMPI_Waitall(count, requests, statuses);
+    if (tracked) {
+        recordWait(entries, count, PROFILE_WAITALL, start);
+    } else {
+        record(PROFILE_WAITALL, start, 0.0);
+    }
+    return error;
+}
+
+int MPI_Start(MPI_Request* request) {
+    return startRequest(request);
+}
+
+int MPI_Startall(int count, MPI_Request requests[]) {
+    int error = MPI_SUCCESS;
+    for (int i = 0; i < count && error == MPI_SUCCESS; i++) {
+        error = startRequest(&requests[i]);
+    }
+    return error;
+}
+
+int MPI_Request_free(MPI_Request* request) {
+    PersistentRequest* entry = findPersistent(*request);
+    if (entry != NULL) {
+        *entry = persistent[--persistentCount];
+    }
+    return PMPI_Request_free(request);
+}
+
+#if MPI_VERSION >= 4
+// Function to remember the request of a persistent collective; beyond MAX_PERSISTENT live requests the
+// starts are only booked under MPI_Start
+static void addPersistent(MPI_Request request, ProfiledCall call, double bytes, MPI_Comm comm) {
+    if (persistentCount < MAX_PERSISTENT) {
+        PersistentRequest entry = {request, call, bytes, comm, 0};
+        persistent[persistentCount++] = entry;
+    }
+}
+
+int MPI_Allreduce_init(const void* sendbuf, void* recvbuf, int count, MPI_Datatype datatype, MPI_Op op, MPI_Comm comm,
+                       MPI_Info info, MPI_Request* request) {
+    int error = PMPI_Allreduce_init(sendbuf, recvbuf, count, datatype, op, comm, info, request);
+    if (error == MPI_SUCCESS) {
+        addPersistent(*request, PROFILE_ALLREDUCE_INIT, 2.0 * typeBytes(datatype, count), comm);
+    }
+    return error;
+}
+
+int MPI_Allgatherv_init(const void* sendbuf, int sendcount, MPI_Datatype sendtype, void* recvbuf, const int recvcounts[],
+                        const int displs[], MPI_Datatype recvtype, MPI_Comm comm, MPI_Info info, MPI_Request* request) {
+    int error = PMPI_Allgatherv_init(sendbuf, sendcount, sendtype, recvbuf, recvcounts, displs, recvtype, comm, info,
+                                     request);
+    if (error == MPI_SUCCESS) {
+        double bytes = (sendbuf == MPI_IN_PLACE ? 0.0 : typeBytes(sendtype, sendcount)) +
+                       countsBytes(recvtype, recvcounts, comm);
+        addPersistent(*request, PROFILE_ALLGATHERV_INIT, bytes, comm);
+    }
+    return error;
+}
+
+int MPI_Reduce_scatter_init(const void* sendbuf, void* recvbuf, const int recvcounts[], MPI_Datatype datatype, MPI_Op op,
+                            MPI_Comm comm, MPI_Info info, MPI_Request* request) {
+    int error = PMPI_Reduce_scatter_init(sendbuf, recvbuf, recvcounts, datatype, op, comm, info, request);
+    if (error == MPI_SUCCESS) {
+        int rank;
+        PMPI_Comm_rank(comm, &rank);
+        addPersistent(*request, PROFILE_REDUCE_SCATTER_INIT,
+                      countsBytes(datatype, recvcounts, comm) + typeBytes(datatype, recvcounts[rank]), comm);
+    }
+    return error;
+}
+#endif
+
+int MPI_Win_sync(MPI_Win win) {
+    double start = PMPI_Wtime();
+    int error = PMPI_Win_sync(win);
+    record(PROFILE_WIN_SYNC, start, 0.0);
+    return error;
+}
+
+int MPI_Win_lock_all(int assertion, MPI_Win win) {
+    double start = PMPI_Wtime();
+    int error = PMPI_Win_lock_all(assertion, win);
+    record(PROFILE_WIN_LOCK_ALL, start, 0.0);
+    return error;
+}
+
+int MPI_Win_unlock_all(MPI_Win win) {
+    double start = PMPI_Wtime();
+    int error = PMPI_Win_unlock_all(win);
+    record(PROFILE_WIN_UNLOCK_ALL, start, 0.0);
+    return error;
+}
+
+int MPI_File_read_at_all(MPI_File file, MPI_Offset offset, void* buf, int count, MPI_Datatype datatype, MPI_Status* status) {
+    double start = PMPI_Wtime();
+    int error = PMPI_File_read_at_all(file, offset, buf, count, datatype, status);
+    record(PROFILE_FILE_READ_AT_ALL, start, typeBytes(datatype, count));
+    return error;
+}
+
+int MPI_File_write_at_all(MPI_File file, MPI_Offset offset, const void* buf, int count, MPI_Datatype datatype,
+                          MPI_Status* status) {
+    double start = PMPI_Wtime();
+    int error = PMPI_File_write_at_all(file, offset, buf, count, datatype, status);
+    record(PROFILE_FILE_WRITE_AT_ALL, start, typeBytes(datatype, count));
+    return error;
+}
+
+// Function to format a byte count with a binary unit
+static void formatBytes(double bytes, char* text, size_t length) {
+    static const char* const units[] = {"B", "KiB", "MiB", "GiB", "TiB"};
+    int unit = 0;
+    while (bytes >= 1024.0 && unit < 4) {
+        bytes /= 1024.0;
+        unit++;
+    }
+    snprintf(text, length, unit == 0 ? "%.0f %s" : "%.2f %s", bytes, units[unit]);
+}
+
+// Function to print the merged report on rank 0: the counters of all ranks are summed, and the time of
+// every call is also reduced to its maximum, so mean vs slowest rank shows the imbalance
+static void printReport(void) {
+    int rank, size;
+    PMPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    PMPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    // Per rank: the call counters, then the wall time, the time in MPI, the wait time and the compute time
+    enum { VALUES = PROFILE_CALLS * STATS_FIELDS + 4, WALL = VALUES - 4, IN_MPI = VALUES - 3, WAIT = VALUES - 2,
+           COMPUTE = VALUES - 1 };
+    double local[VALUES], sums[VALUES], maxima[VALUES], minima[VALUES];
+    memcpy(local, stats, sizeof(stats));
+    double mpiSeconds = 0.0, waitSeconds = 0.0;
+    for (int c = 0; c < PROFILE_CALLS; c++) {
+        mpiSeconds += stats[c].seconds + stats[c].wait;
+        waitSeconds += stats[c].wait;
+    }
+    local[WALL] = PMPI_Wtime() - startTime;
+    local[IN_MPI] = mpiSeconds;
+    local[WAIT] = waitSeconds;
+    local[COMPUTE] = local[WALL] - mpiSeconds;
+    PMPI_Reduce(local, sums, VALUES, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+    PMPI_Reduce(local, maxima, VALUES, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    PMPI_Reduce(local, minima, VALUES, MPI_DOUBLE, MPI_MIN, 0, MPI_COMM_WORLD);
+
+    double* perRank = NULL;
+    if (perRankReport) {
+        perRank = rank == 0 ? (double*)malloc(4 * (size_t)size * sizeof(double)) : NULL;
+        PMPI_Gather(local + WALL, 4, MPI_DOUBLE, perRank, 4, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    }
+    if (rank != 0) {
+        return;
+    }
+
+    fprintf(stderr, "\nMPI profile of %d ranks: wall %.6f s, MPI %.6f s mean / %.6f s max per rank, "
+                    "compute %.6f s mean per rank%s\n",
+            size, maxima[WALL], sums[IN_MPI] / size, maxima[IN_MPI], sums[COMPUTE] / size,
+            syncCollectives ? " (collectives synchronised)" : "");
+    fprintf(stderr, "%-24s %10s %14s %12s %12s %10s%s\n", "Call", "Calls", "Bytes", "Mean s", "Max s", "Max/mean",
+            syncCollectives ? "       Wait s" : "");
+    for (int c = 0; c < PROFILE_CALLS; c++) {
+        const double* sum = &sums[c * STATS_FIELDS];
+        const double* max = &maxima[c * STATS_FIELDS];
+        if (sum[0] == 0.0) {
+            continue;
+        }
+        char bytes[32];
+        formatBytes(sum[1], bytes, sizeof(bytes));
+        double mean = sum[2] / size;
+        fprintf(stderr, "%-24s %10.0f %14s %12.6f %12.6f %10.2f", profiledNames[c], sum[0], bytes, mean, max[2],
+                mean > 0.0 ? max[2] / mean : 1.0);
+        if (syncCollectives) {
+            fprintf(stderr, " %12.6f", sum[3] / size);
+        }
+        fprintf(stderr, "\n");
+    }
+    fprintf(stderr, "Compute (outside MPI) per rank: min %.6f s, max %.6f s\n", minima[COMPUTE], maxima[COMPUTE]);
+    if (perRank != NULL) {
+        for (int r = 0; r < size; r++) {
+            const double* values = &perRank[4 * (size_t)r];
+            fprintf(stderr, "Rank %d: compute %.6f s, MPI %.6f s (wait %.6f s)\n", r, values[3], values[1], values[2]);
+        }
+        free(perRank);
+    }
+}
+
+int MPI_Finalize(void) {
+    printReport();
+    return PMPI_Finalize();
+}